@@ -0,0 +1,395 @@
+#include "devices/block.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* The code in this file is the layer between block device
+   drivers and their users.  Every request passes through
+   block_submit() on its way to the driver and block_complete()
+   on its way back, which is where per-device statistics are
+   kept, so the statistics cover every driver alike. */
+
+/* Number of buckets in each device's latency histogram.  Bucket
+   0 counts latencies under 2 us, bucket I for 0 < I <
+   LATENCY_BUCKETS - 1 counts those from 2**I up to 2**(I+1) us,
+   and the last bucket counts everything longer. */
+#define LATENCY_BUCKETS 20
+
+/* block_copy() moves data in chunks of COPY_CHUNK sectors, one
+   page each, with up to COPY_DEPTH chunks in flight. */
+#define COPY_CHUNK (PGSIZE / DISK_SECTOR_SIZE)
+#define COPY_DEPTH 4
+
+/* A block device. */
+struct block
+  {
+    struct list_elem elem;              /* Element in all_blocks. */
+    char name[16];                      /* Name, e.g. "hd0:1". */
+    disk_sector_t size;                 /* Size in sectors. */
+    const struct block_operations *ops; /* Driver operations. */
+    void *aux;                          /* Driver data. */
+
+    /* Statistics, protected by disabling interrupts. */
+    long long read_cnt;                 /* Sectors read. */
+    long long write_cnt;                /* Sectors written. */
+    long long request_cnt;              /* Requests submitted. */
+    int depth;                          /* Requests outstanding. */
+    int max_depth;                      /* Maximum of DEPTH. */
+    long long depth_sum;                /* Sum of DEPTH at submission. */
+    long long latency[LATENCY_BUCKETS]; /* Histogram of per-sector
+                                           latency of requests. */
+  };
+
+/* All registered block devices, in order of registration. */
+static struct list all_blocks;
+
+/* The device playing each role. */
+static struct block *roles[BLOCK_ROLE_CNT];
+
+/* Time-stamp counter increments per microsecond. */
+static uint64_t tsc_per_us = 1;
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Initializes the block layer.  Also measures the rate of the
+   time-stamp counter against the timer, for the latency
+   histograms, by busy-waiting for a few ticks. */
+void
+block_init (void)
+{
+  int64_t start;
+  uint64_t tsc;
+
+  list_init (&all_blocks);
+
+  /* Start on a tick boundary, then count over two ticks. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  tsc = rdtsc ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 2)
+    barrier ();
+  tsc_per_us = (rdtsc () - tsc) / (2 * (1000 * 1000 / TIMER_FREQ));
+  if (tsc_per_us == 0)
+    tsc_per_us = 1;
+}
+
+/* Registers a block device named NAME with SIZE sectors, driven
+   by OPS with driver data AUX, and returns it. */
+struct block *
+block_register (const char *name, disk_sector_t size,
+                const struct block_operations *ops, void *aux)
+{
+  struct block *b = malloc (sizeof *b);
+  if (b == NULL)
+    PANIC ("failed to allocate block device");
+
+  memset (b, 0, sizeof *b);
+  strlcpy (b->name, name, sizeof b->name);
+  b->size = size;
+  b->ops = ops;
+  b->aux = aux;
+  list_push_back (&all_blocks, &b->elem);
+  return b;
+}
+
+/* Returns the block device playing ROLE, or a null pointer if
+   there is none. */
+struct block *
+block_get_role (enum block_role role)
+{
+  ASSERT (role < BLOCK_ROLE_CNT);
+  return roles[role];
+}
+
+/* Makes BLOCK play ROLE, in place of any other device. */
+void
+block_set_role (enum block_role role, struct block *block)
+{
+  ASSERT (role < BLOCK_ROLE_CNT);
+  roles[role] = block;
+}
+
+/* Returns BLOCK's name, e.g. "hd0:1". */
+const char *
+block_name (const struct block *block)
+{
+  return block->name;
+}
+
+/* Returns BLOCK's size in DISK_SECTOR_SIZE-byte sectors. */
+disk_sector_t
+block_size (const struct block *block)
+{
+  return block->size;
+}
+
+/* Returns the driver data that BLOCK was registered with. */
+void *
+block_aux (const struct block *block)
+{
+  return block->aux;
+}
+
+/* Reads sector SEC_NO from BLOCK into BUFFER, which must have
+   room for DISK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to devices, so external
+   per-device locking is unneeded. */
+void
+block_read (struct block *block, disk_sector_t sec_no, void *buffer)
+{
+  block_read_multiple (block, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to BLOCK from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the device has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to devices, so external
+   per-device locking is unneeded. */
+void
+block_write (struct block *block, disk_sector_t sec_no, const void *buffer)
+{
+  block_write_multiple (block, sec_no, 1, buffer);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from BLOCK
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  CNT must be between 1 and BLOCK_TRANSFER_MAX. */
+void
+block_read_multiple (struct block *block, disk_sector_t sec_no, size_t cnt,
+                     void *buffer)
+{
+  struct block_request r;
+
+  r.sec_no = sec_no;
+  r.cnt = cnt;
+  r.buffer = buffer;
+  r.write = false;
+  r.func = NULL;
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to BLOCK
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   CNT must be between 1 and BLOCK_TRANSFER_MAX.  Returns after
+   the device has acknowledged receiving all of the data. */
+void
+block_write_multiple (struct block *block, disk_sector_t sec_no, size_t cnt,
+                      const void *buffer)
+{
+  struct block_request r;
+
+  r.sec_no = sec_no;
+  r.cnt = cnt;
+  r.buffer = (void *) buffer;
+  r.write = true;
+  r.func = NULL;
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Copies the CNT sectors starting at SRC_SEC on SRC to the CNT
+   sectors starting at DST_SEC on DST.  The two ranges must not
+   overlap.
+
+   Reads run ahead of writes by up to COPY_DEPTH chunks, so
+   while a chunk is being written the next ones are being read.
+   If SRC and DST can transfer independently, as disks on
+   different ATA channels can, both stay busy. */
+void
+block_copy (struct block *dst, disk_sector_t dst_sec,
+            struct block *src, disk_sector_t src_sec, size_t cnt)
+{
+  struct copy_slot
+    {
+      struct block_request read, write;
+      void *buffer;
+    }
+  slots[COPY_DEPTH];
+  size_t chunk_cnt = DIV_ROUND_UP (cnt, COPY_CHUNK);
+  size_t i;
+
+  ASSERT (src_sec + cnt <= src->size);
+  ASSERT (dst_sec + cnt <= dst->size);
+
+  if (cnt == 0)
+    return;
+  for (i = 0; i < COPY_DEPTH; i++)
+    {
+      struct copy_slot *s = &slots[i];
+
+      s->buffer = palloc_get_page (PAL_ASSERT);
+      s->read.buffer = s->write.buffer = s->buffer;
+      s->read.write = false;
+      s->write.write = true;
+      s->read.func = s->write.func = NULL;
+    }
+
+  /* Chunk I always uses slot I % COPY_DEPTH. */
+  for (i = 0; i < chunk_cnt + COPY_DEPTH; i++)
+    {
+      struct copy_slot *s = &slots[i % COPY_DEPTH];
+
+      /* Write chunk I - COPY_DEPTH, whose read was queued a full
+         round ago, and wait for the slot to be free again. */
+      if (i >= COPY_DEPTH)
+        {
+          size_t ofs = (i - COPY_DEPTH) * COPY_CHUNK;
+
+          block_wait (&s->read);
+          s->write.sec_no = dst_sec + ofs;
+          s->write.cnt = s->read.cnt;
+          block_submit (dst, &s->write);
+          block_wait (&s->write);
+        }
+
+      /* Queue the read of chunk I. */
+      if (i < chunk_cnt)
+        {
+          size_t ofs = i * COPY_CHUNK;
+
+          s->read.sec_no = src_sec + ofs;
+          s->read.cnt = cnt - ofs < COPY_CHUNK ? cnt - ofs : COPY_CHUNK;
+          block_submit (src, &s->read);
+        }
+    }
+
+  for (i = 0; i < COPY_DEPTH; i++)
+    palloc_free_page (slots[i].buffer);
+}
+
+/* Starts request R on BLOCK and returns without waiting for it.
+   When R completes, R->func is called, possibly from another
+   thread, if it is nonnull; otherwise block_wait() may be used
+   to wait for R.  R->cnt must be between 1 and
+   BLOCK_TRANSFER_MAX.
+
+   Requests are not necessarily done in the order they are
+   submitted, so the caller must not have two requests that
+   overlap and include a write outstanding at once. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  enum intr_level old_level;
+
+  ASSERT (block != NULL);
+  ASSERT (r != NULL);
+  ASSERT (r->buffer != NULL);
+  ASSERT (r->cnt > 0 && r->cnt <= BLOCK_TRANSFER_MAX);
+  ASSERT (r->sec_no + r->cnt <= block->size);
+
+  r->block = block;
+  r->submit_time = rdtsc ();
+  sema_init (&r->done, 0);
+
+  old_level = intr_disable ();
+  block->request_cnt++;
+  block->depth_sum += block->depth++;
+  if (block->depth > block->max_depth)
+    block->max_depth = block->depth;
+  intr_set_level (old_level);
+
+  block->ops->submit (block->aux, r);
+}
+
+/* Waits for request R, which must have been submitted with a
+   null completion callback, to complete. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->func == NULL);
+  sema_down (&r->done);
+}
+
+/* Called by a driver when request R is done.  Records R in its
+   device's statistics and notifies R's submitter. */
+void
+block_complete (struct block_request *r)
+{
+  struct block *block = r->block;
+  uint64_t us = (rdtsc () - r->submit_time) / tsc_per_us / r->cnt;
+  enum intr_level old_level;
+  int bucket;
+
+  for (bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+    if (us < (2u << bucket))
+      break;
+
+  old_level = intr_disable ();
+  if (r->write)
+    block->write_cnt += r->cnt;
+  else
+    block->read_cnt += r->cnt;
+  block->depth--;
+  block->latency[bucket]++;
+  intr_set_level (old_level);
+
+  if (r->func != NULL)
+    r->func (r);
+  else
+    sema_up (&r->done);
+}
+
+/* Prints the nonempty buckets of BLOCK's latency histogram. */
+static void
+print_latency (const struct block *block)
+{
+  bool any = false;
+  int i;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (block->latency[i] != 0)
+      {
+        if (!any)
+          printf ("%s: latency per sector:", block->name);
+        any = true;
+
+        if (i == 0)
+          printf (" <2 us: %lld", block->latency[i]);
+        else if (i < LATENCY_BUCKETS - 1)
+          printf (" %d-%d us: %lld", 1 << i, (1 << (i + 1)) - 1,
+                  block->latency[i]);
+        else
+          printf (" >=%d us: %lld", 1 << i, block->latency[i]);
+      }
+  if (any)
+    printf ("\n");
+}
+
+/* Prints statistics for each block device. */
+void
+block_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, elem);
+      long long depth10 = (block->request_cnt > 0
+                           ? block->depth_sum * 10 / block->request_cnt
+                           : 0);
+
+      printf ("%s: %lld reads, %lld writes, %lld requests, "
+              "queue depth %lld.%lld average, %d maximum\n",
+              block->name, block->read_cnt, block->write_cnt,
+              block->request_cnt, depth10 / 10, depth10 % 10,
+              block->max_depth);
+      print_latency (block);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef DEVICES_BLOCK_H
+#define DEVICES_BLOCK_H
+
+#include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Size of a sector in bytes. */
+#define DISK_SECTOR_SIZE 512
+
+/* Index of a sector within a block device.
+   Good enough for devices up to 2 TB. */
+typedef uint32_t disk_sector_t;
+
+/* Format specifier for printf(), e.g.:
+   printf ("sector=%"PRDSNu"\n", sector); */
+#define PRDSNu PRIu32
+
+/* Maximum number of sectors in one request. */
+#define BLOCK_TRANSFER_MAX 256
+
+/* Roles that block devices play. */
+enum block_role 
+  {
+    BLOCK_FILESYS,              /* File system. */
+    BLOCK_SCRATCH,              /* Scratch, for `put' and `get'. */
+    BLOCK_SWAP,                 /* Swap. */
+    BLOCK_ROLE_CNT
+  };
+
+/* A block device. */
+struct block;
+
+/* An asynchronous request, for block_submit().  The caller fills
+   in the members above the line and must keep the request and
+   its buffer alive until it completes. */
+struct block_request
+  {
+    disk_sector_t sec_no;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+    bool write;                 /* Write (true) or read (false)? */
+    void (*func) (struct block_request *); /* Completion callback. */
+    void *aux;                  /* For use by FUNC. */
+
+    /* ---- Owned by the block layer and the driver. ---- */
+    struct block *block;        /* Device submitted to. */
+    uint64_t submit_time;       /* Time-stamp counter at submission. */
+    struct semaphore done;      /* Up'd on completion if FUNC is null. */
+    struct list_elem elem;      /* For the driver's use. */
+    int64_t deadline;           /* For the driver's use. */
+  };
+
+/* Operations that a block device driver provides. */
+struct block_operations 
+  {
+    /* Starts request R on the device whose driver data is AUX,
+       without waiting for it to finish.  The driver calls
+       block_complete() when R is done. */
+    void (*submit) (void *aux, struct block_request *r);
+  };
+
+void block_init (void);
+struct block *block_register (const char *name, disk_sector_t size,
+                              const struct block_operations *, void *aux);
+struct block *block_get_role (enum block_role);
+void block_set_role (enum block_role, struct block *);
+const char *block_name (const struct block *);
+disk_sector_t block_size (const struct block *);
+void *block_aux (const struct block *);
+
+void block_read (struct block *, disk_sector_t, void *);
+void block_write (struct block *, disk_sector_t, const void *);
+void block_read_multiple (struct block *, disk_sector_t, size_t cnt, void *);
+void block_write_multiple (struct block *, disk_sector_t, size_t cnt,
+                           const void *);
+void block_copy (struct block *dst, disk_sector_t dst_sec,
+                 struct block *src, disk_sector_t src_sec, size_t cnt);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+void block_complete (struct block_request *);
+
+void block_print_stats (void);
+
+#endif /* devices/block.h */
@@ -3,13 +3,19 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  Where the
+   controller is a PCI bus master, such as the PIIX family that
+   QEMU and Bochs emulate, data moves by DMA; otherwise, and if
+   DMA fails, by PIO. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -32,6 +38,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +54,60 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus master IDE port addresses, relative to a channel's
+   bm_base. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits.  ERR and INTR are cleared by
+   writing 1 to them. */
+#define BM_ST_ACTIVE 0x01       /* Transfer in progress. */
+#define BM_ST_ERR 0x02          /* Transfer failed. */
+#define BM_ST_INTR 0x04         /* Device raised its interrupt. */
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where to move data.  A region may not
+   cross a 64 kB boundary, and a SIZE of 0 means 64 kB. */
+struct prd 
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes. */
+    uint16_t flags;             /* PRD_EOT for the last entry. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Maximum number of regions in one transfer.  A transfer that
+   needs more is done by PIO instead. */
+#define PRD_MAX 64
+
+/* Maximum number of queued requests merged into one command. */
+#define MERGE_MAX 32
+
+/* Ticks a request may wait in a queue before it is served ahead
+   of the elevator's order.  Readers are usually waiting for
+   their data, so reads get the shorter deadline. */
+#define READ_DEADLINE_TICKS (TIMER_FREQ / 20)
+#define WRITE_DEADLINE_TICKS (TIMER_FREQ / 2)
+
+/* Status waits poll this many times before sleeping for a timer
+   tick between polls. */
+#define SPIN_CNT 64
+
+/* If true, never use DMA.  Set by the kernel command line
+   option -pio. */
+bool disk_pio_only;
 
 /* An ATA device. */
 struct disk 
@@ -57,9 +118,14 @@ struct disk
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
-
-    long long read_cnt;         /* Number of sectors read. */
-    long long write_cnt;        /* Number of sectors written. */
+    size_t block_size;          /* Sectors per interrupt for READ/WRITE
+                                   MULTIPLE, or 1 if not in use. */
+    bool use_dma;               /* Transfer data by DMA? */
+    struct block *block;        /* Block device, if is_ata. */
+
+    long long command_cnt;      /* Number of transfer commands. */
+    long long seek_distance;    /* Total sectors between commands. */
+    disk_sector_t head;         /* Sector after the last transferred. */
   };
 
 /* An ATA channel (aka controller).
@@ -70,38 +136,85 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    uint8_t status;             /* Status read by interrupt handler. */
+    const struct disk *selected;        /* Selected device, if known. */
+
+    /* Once disk_init() finishes, only the channel's worker thread
+       touches the controller.  Other threads queue requests. */
+    struct lock lock;           /* Protects QUEUE and HEAD. */
+    struct condition queue_cond;        /* Signaled when QUEUE grows. */
+    struct list queue;          /* Pending requests, by queue_key(). */
+    uint32_t head;              /* queue_key() of the elevator's position. */
+
+    uint16_t bm_base;           /* Bus master I/O base, 0 if none. */
+    struct prd *prdt;           /* Physical region descriptor table. */
 
     struct disk devices[2];     /* The devices on this channel. */
   };
 
+/* A group of queued requests for consecutive sectors in the same
+   direction on the same disk, done with a single command. */
+struct batch 
+  {
+    struct disk *disk;          /* Disk. */
+    disk_sector_t sec_no;       /* First sector. */
+    size_t cnt;                 /* Total number of sectors. */
+    bool write;                 /* Direction. */
+    struct block_request *reqs[MERGE_MAX]; /* Requests, in sector order. */
+    size_t req_cnt;             /* Number of requests. */
+  };
+
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* PRD tables for the channels.  Aligning each table to its own
+   size keeps it from crossing a 64 kB boundary, as required. */
+static struct prd prd_tables[CHANNEL_CNT][PRD_MAX]
+  __attribute__ ((aligned (sizeof (struct prd) * PRD_MAX)));
+
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static void set_multiple_mode (struct disk *, size_t block_size);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
-
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
+static void ata_submit (void *, struct block_request *);
+static thread_func channel_worker NO_RETURN;
+static uint32_t queue_key (const struct block_request *);
+static list_less_func request_less;
+static void take_batch (struct channel *, struct batch *);
+static void pio_transfer (const struct batch *);
+static bool dma_transfer (const struct batch *);
+
+static bool wait_status (const struct disk *, uint8_t mask,
+                         int64_t timeout_ms);
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
 static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void assign_role (enum block_role, int chan_no, int dev_no);
+
+/* Block device operations for ATA disks. */
+static const struct block_operations ata_operations = 
+  {
+    ata_submit,
+  };
 
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -124,9 +237,16 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->status = 0;
+      c->selected = NULL;
+      lock_init (&c->lock);
+      cond_init (&c->queue_cond);
+      list_init (&c->queue);
+      c->head = 0;
+      c->bm_base = bm_base != 0 ? bm_base + 8 * chan_no : 0;
+      c->prdt = prd_tables[chan_no];
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -138,8 +258,12 @@ disk_init (void)
 
           d->is_ata = false;
           d->capacity = 0;
+          d->block_size = 1;
+          d->use_dma = false;
+          d->block = NULL;
 
-          d->read_cnt = d->write_cnt = 0;
+          d->command_cnt = d->seek_distance = 0;
+          d->head = 0;
         }
 
       /* Register interrupt handler. */
@@ -152,14 +276,31 @@ disk_init (void)
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
 
-      /* Read hard disk identity information. */
+      /* Read hard disk identity information and register each
+         disk as a block device. */
       for (dev_no = 0; dev_no < 2; dev_no++)
-        if (c->devices[dev_no].is_ata)
-          identify_ata_device (&c->devices[dev_no]);
+        {
+          struct disk *d = &c->devices[dev_no];
+          if (d->is_ata)
+            identify_ata_device (d);
+          if (d->is_ata)
+            d->block = block_register (d->name, d->capacity,
+                                       &ata_operations, d);
+        }
+
+      /* Start serving requests. */
+      if (c->devices[0].is_ata || c->devices[1].is_ata)
+        thread_create (c->name, PRI_MAX, channel_worker, c);
     }
+
+  /* Assign roles by position, unless already assigned. */
+  assign_role (BLOCK_FILESYS, 0, 1);
+  assign_role (BLOCK_SCRATCH, 1, 0);
+  assign_role (BLOCK_SWAP, 1, 1);
 }
 
-/* Prints disk statistics. */
+/* Prints disk statistics.  Per-request statistics are printed by
+   block_print_stats(). */
 void
 disk_print_stats (void) 
 {
@@ -172,9 +313,9 @@ disk_print_stats (void)
       for (dev_no = 0; dev_no < 2; dev_no++) 
         {
           struct disk *d = disk_get (chan_no, dev_no);
-          if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+          if (d != NULL) 
+            printf ("%s: %lld commands, seek distance %lld sectors\n",
+                    d->name, d->command_cnt, d->seek_distance);
         }
     }
 }
@@ -202,69 +343,323 @@ disk_get (int chan_no, int dev_no)
   return NULL;
 }
 
-/* Returns the size of disk D, measured in DISK_SECTOR_SIZE-byte
-   sectors. */
-disk_sector_t
-disk_size (struct disk *d) 
+/* Returns the block device for disk D. */
+struct block *
+disk_get_block (struct disk *d) 
 {
   ASSERT (d != NULL);
-  
-  return d->capacity;
+
+  return d->block;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for DISK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-void
-disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
+/* Makes the disk numbered DEV_NO on channel CHAN_NO play ROLE, if
+   the disk exists and no other device plays ROLE already. */
+static void
+assign_role (enum block_role role, int chan_no, int dev_no) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
+  struct disk *d = disk_get (chan_no, dev_no);
+
+  if (d != NULL && block_get_role (role) == NULL)
+    block_set_role (role, d->block);
+}
+
+/* Queues request R for the disk whose struct disk is D_ and
+   returns at once.  The block layer has already checked R.
+   The channel's worker thread completes R. */
+static void
+ata_submit (void *d_, struct block_request *r) 
+{
+  struct disk *d = d_;
+  struct channel *c = d->channel;
+
+  r->deadline = timer_ticks () + (r->write
+                                  ? WRITE_DEADLINE_TICKS
+                                  : READ_DEADLINE_TICKS);
 
-  c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
+  list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+  cond_signal (&c->queue_cond, &c->lock);
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
+/* Serves the requests queued for channel C_, one batch at a
+   time. */
+static void
+channel_worker (void *c_) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
+  struct channel *c = c_;
 
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
+  for (;;) 
+    {
+      struct batch b;
+      size_t i;
+
+      lock_acquire (&c->lock);
+      while (list_empty (&c->queue))
+        cond_wait (&c->queue_cond, &c->lock);
+      take_batch (c, &b);
+      lock_release (&c->lock);
+
+      if (!dma_transfer (&b))
+        pio_transfer (&b);
+
+      b.disk->command_cnt++;
+      b.disk->seek_distance += (b.sec_no > b.disk->head
+                                ? b.sec_no - b.disk->head
+                                : b.disk->head - b.sec_no);
+      b.disk->head = b.sec_no + b.cnt;
+
+      for (i = 0; i < b.req_cnt; i++)
+        block_complete (b.reqs[i]);
+    }
+}
+
+/* Returns the key by which request R is ordered in its channel's
+   queue: its disk, then its sector number. */
+static uint32_t
+queue_key (const struct block_request *r) 
+{
+  const struct disk *d = block_aux (r->block);
+  return ((uint32_t) d->dev_no << 28) | r->sec_no;
+}
+
+/* Orders requests A_ and B_ by queue_key(). */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED) 
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return queue_key (a) < queue_key (b);
+}
+
+/* Removes the next batch of requests to do from channel C's
+   queue, which must not be empty, and stores it in B.  The
+   caller must hold C's lock.
+
+   Requests are taken in C-LOOK order: in ascending order of
+   queue_key() from where the last batch ended, then starting
+   over from the lowest.  A request that has waited past its
+   deadline goes first, though.  Queued requests that continue
+   the first one are merged into the batch. */
+static void
+take_batch (struct channel *c, struct batch *b) 
+{
+  int64_t now = timer_ticks ();
+  struct block_request *first = NULL;
+  struct block_request *oldest = NULL;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (!list_empty (&c->queue));
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (first == NULL && queue_key (r) >= c->head)
+        first = r;
+      if (r->deadline <= now
+          && (oldest == NULL || r->deadline < oldest->deadline))
+        oldest = r;
+    }
+  if (oldest != NULL)
+    first = oldest;
+  else if (first == NULL)
+    first = list_entry (list_front (&c->queue), struct block_request, elem);
+
+  b->disk = block_aux (first->block);
+  b->sec_no = first->sec_no;
+  b->cnt = 0;
+  b->write = first->write;
+  b->req_cnt = 0;
+  e = &first->elem;
+  for (;;) 
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+
+      b->reqs[b->req_cnt++] = r;
+      b->cnt += r->cnt;
+      e = list_remove (e);
+      if (e == list_end (&c->queue) || b->req_cnt >= MERGE_MAX)
+        break;
+
+      r = list_entry (e, struct block_request, elem);
+      if (block_aux (r->block) != b->disk || r->write != b->write
+          || r->sec_no != b->sec_no + b->cnt
+          || b->cnt + r->cnt > BLOCK_TRANSFER_MAX)
+        break;
+    }
+  c->head = queue_key (first) + b->cnt;
+}
+
+/* Returns the address of the sector at index IDX within batch B's
+   buffers. */
+static uint8_t *
+batch_sector (const struct batch *b, size_t idx) 
+{
+  size_t i;
+
+  for (i = 0; i < b->req_cnt; i++) 
+    {
+      if (idx < b->reqs[i]->cnt)
+        return (uint8_t *) b->reqs[i]->buffer + idx * DISK_SECTOR_SIZE;
+      idx -= b->reqs[i]->cnt;
+    }
+  NOT_REACHED ();
+}
+
+/* Does batch B by PIO, interrupting once per block of its disk's
+   block_size sectors. */
+static void
+pio_transfer (const struct batch *b) 
+{
+  struct disk *d = b->disk;
+  struct channel *c = d->channel;
+  size_t ofs, i;
+
+  select_sector (d, b->sec_no, b->cnt);
+  if (!b->write) 
+    {
+      issue_pio_command (c, (d->block_size > 1
+                             ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY));
+      for (ofs = 0; ofs < b->cnt; ofs += d->block_size)
+        {
+          sema_down (&c->completion_wait);
+          if ((c->status & (STA_BSY | STA_DRQ)) != STA_DRQ
+              && !wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, b->sec_no + ofs);
+          for (i = ofs; i < b->cnt && i < ofs + d->block_size; i++)
+            input_sectors (c, batch_sector (b, i), 1);
+        }
+    }
+  else 
+    {
+      issue_pio_command (c, (d->block_size > 1
+                             ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY));
+      for (ofs = 0; ofs < b->cnt; ofs += d->block_size)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, b->sec_no + ofs);
+          for (i = ofs; i < b->cnt && i < ofs + d->block_size; i++)
+            output_sectors (c, batch_sector (b, i), 1);
+          sema_down (&c->completion_wait);
+        }
+    }
+}
+
+/* Does batch B by bus master DMA, gathering from or scattering
+   to the requests' buffers.  Returns false, having transferred
+   nothing, if B cannot be done by DMA; on failure, also stops
+   B's disk from trying DMA again, so that the caller's fallback
+   to PIO sticks. */
+static bool
+dma_transfer (const struct batch *b) 
+{
+  struct disk *d = b->disk;
+  struct channel *c = d->channel;
+  size_t prd_cnt = 0;
+  uint8_t command, bm_status, status;
+  size_t i;
+
+  if (!d->use_dma)
+    return false;
+
+  /* Describe each buffer, splitting it at 64 kB boundaries.  The
+     bus master needs physical addresses, so each buffer must be
+     in the kernel's linear mapping of RAM, and it only moves
+     whole 16-bit words. */
+  for (i = 0; i < b->req_cnt; i++) 
+    {
+      const void *buffer = b->reqs[i]->buffer;
+      uintptr_t paddr;
+      size_t size;
+
+      if (!is_kernel_vaddr (buffer) || (uintptr_t) buffer % 2)
+        return false;
+      paddr = vtop (buffer);
+      for (size = b->reqs[i]->cnt * DISK_SECTOR_SIZE; size > 0; prd_cnt++) 
+        {
+          size_t region = 0x10000 - (paddr & 0xffff);
+          if (region > size)
+            region = size;
+
+          if (prd_cnt >= PRD_MAX)
+            return false;
+          c->prdt[prd_cnt].addr = paddr;
+          c->prdt[prd_cnt].size = region & 0xffff;
+          c->prdt[prd_cnt].flags = 0;
+          paddr += region;
+          size -= region;
+        }
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+  /* Program the bus master, start the disk, then start the bus
+     master, and sleep until the disk interrupts. */
+  command = b->write ? 0 : BM_CMD_READ;
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), command);
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_ST_ERR | BM_ST_INTR);
+  select_sector (d, b->sec_no, b->cnt);
+  issue_pio_command (c, b->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), command | BM_CMD_START);
   sema_down (&c->completion_wait);
-  d->write_cnt++;
-  lock_release (&c->lock);
+
+  /* Stop the bus master and check for errors. */
+  outb (reg_bm_command (c), command);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status | BM_ST_ERR | BM_ST_INTR);
+  status = c->status;
+  if (status & STA_BSY) 
+    {
+      wait_while_busy (d);
+      status = inb (reg_alt_status (c));
+    }
+  if ((bm_status & (BM_ST_ERR | BM_ST_ACTIVE)) || (status & STA_ERR)) 
+    {
+      printf ("%s: DMA transfer failed, sector=%"PRDSNu", using PIO\n",
+              d->name, b->sec_no);
+      d->use_dma = false;
+      return false;
+    }
+  return true;
 }
-
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
 
+/* Finds a PCI IDE controller that can act as a bus master and
+   returns the I/O base of its bus master registers, with the
+   primary channel's at offset 0 and the secondary's at offset 8.
+   Returns 0 if there is no such controller or DMA is disabled. */
+static uint16_t
+find_bus_master (void) 
+{
+  struct pci_addr addr;
+  uint32_t bar;
+
+  if (disk_pio_only || !pci_find_class (0x01, 0x01, &addr))
+    return 0;
+
+  /* Bit 7 of the programming interface says whether the
+     controller supports bus mastering.  BAR4 holds the bus
+     master registers, which must be in I/O space. */
+  bar = pci_read_config (&addr, PCI_REG_BAR0 + 4 * 4);
+  if (!(pci_read_config (&addr, PCI_REG_CLASS) & 0x8000)
+      || !(bar & 1) || (bar & 0xfffc) == 0)
+    return 0;
+
+  pci_write_config (&addr, PCI_REG_COMMAND,
+                    (pci_read_config (&addr, PCI_REG_COMMAND)
+                     | PCI_CMD_IO | PCI_CMD_MASTER));
+  return bar & 0xfffc;
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -301,6 +696,7 @@ reset_channel (struct channel *c)
   outb (reg_ctl (c), CTL_SRST);
   timer_usleep (10);
   outb (reg_ctl (c), 0);
+  c->selected = NULL;
 
   timer_msleep (150);
 
@@ -381,11 +777,19 @@ identify_ata_device (struct disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
   /* Calculate capacity. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+  /* Word 47 gives the largest block that READ/WRITE MULTIPLE
+     can transfer per interrupt, or 0 if they are unsupported. */
+  if ((id[47] & 0xff) > 1)
+    set_multiple_mode (d, id[47] & 0xff);
+
+  /* Bit 8 of word 49 says whether the disk supports DMA. */
+  d->use_dma = c->bm_base != 0 && (id[49] & 0x100) != 0;
+
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
   if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -404,6 +808,26 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with the largest block
+   size that is a power of 2 and no more than MAX_BLOCK_SIZE
+   sectors.  Leaves D's block_size at 1 if the disk refuses. */
+static void
+set_multiple_mode (struct disk *d, size_t max_block_size) 
+{
+  struct channel *c = d->channel;
+  size_t block_size;
+
+  for (block_size = 1; block_size * 2 <= max_block_size; block_size *= 2)
+    continue;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), block_size);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  if ((c->status & STA_ERR) == 0)
+    d->block_size = block_size;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -426,18 +850,20 @@ print_ata_string (char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection
+   registers.  (We use LBA mode.)  A count of 256 is written as
+   0, as ATA requires. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) 
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) 
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < d->capacity);
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= 256);
+  ASSERT (sec_no + cnt <= d->capacity);
+  ASSERT (sec_no + cnt <= (1UL << 28));
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt & 0xff);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -458,24 +884,72 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, size_t cnt) 
 {
-  insw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain DISK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTORS to channel C's data register in
+   PIO mode.  SECTORS must contain CNT * DISK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, size_t cnt) 
 {
-  outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
 
+/* Waits up to TIMEOUT_MS milliseconds for the bits in MASK to be
+   clear in the status register of disk D's channel, and returns
+   true if they clear in time.
+
+   Emulated disks usually respond within a few status reads, so
+   the register is first polled in a tight loop.  After that, the
+   thread sleeps for a timer tick between polls.  Shorter delays
+   would only busy-wait in the calibrated delay loop, and the
+   channel workers run at PRI_MAX, so they would starve every
+   other thread.  If the wait reaches 7 seconds, a message is
+   printed to explain the delay. */
+static bool
+wait_status (const struct disk *d, uint8_t mask, int64_t timeout_ms) 
+{
+  struct channel *c = d->channel;
+  int64_t timeout = timeout_ms * TIMER_FREQ / 1000;
+  int64_t start;
+  bool warned = false;
+  int i;
+
+  for (i = 0; i < SPIN_CNT; i++)
+    if (!(inb (reg_alt_status (c)) & mask))
+      return true;
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < timeout) 
+    {
+      timer_sleep (1);
+
+      if (!warned && timer_elapsed (start) >= 7 * TIMER_FREQ) 
+        {
+          printf ("%s: busy, waiting...", d->name);
+          warned = true;
+        }
+      if (!(inb (reg_alt_status (c)) & mask)) 
+        {
+          if (warned)
+            printf ("ok\n");
+          return true;
+        }
+    }
+
+  if (warned)
+    printf ("failed\n");
+  return false;
+}
+
 /* Wait up to 10 seconds for the controller to become idle, that
    is, for the BSY and DRQ bits to clear in the status register.
 
@@ -484,16 +958,9 @@ output_sector (struct channel *c, const void *sector)
 static void
 wait_until_idle (const struct disk *d) 
 {
-  int i;
-
-  for (i = 0; i < 1000; i++) 
-    {
-      if ((inb (reg_status (d->channel)) & (STA_BSY | STA_DRQ)) == 0)
-        return;
-      timer_usleep (10);
-    }
-
-  printf ("%s: idle timeout\n", d->name);
+  if (!wait_status (d, STA_BSY | STA_DRQ, 10 * 1000))
+    printf ("%s: idle timeout\n", d->name);
+  inb (reg_status (d->channel));
 }
 
 /* Wait up to 30 seconds for disk D to clear BSY,
@@ -504,23 +971,10 @@ static bool
 wait_while_busy (const struct disk *d) 
 {
   struct channel *c = d->channel;
-  int i;
-  
-  for (i = 0; i < 3000; i++)
-    {
-      if (i == 700)
-        printf ("%s: busy, waiting...", d->name);
-      if (!(inb (reg_alt_status (c)) & STA_BSY)) 
-        {
-          if (i >= 700)
-            printf ("ok\n");
-          return (inb (reg_alt_status (c)) & STA_DRQ) != 0;
-        }
-      timer_msleep (10);
-    }
 
-  printf ("failed\n");
-  return false;
+  if (!wait_status (d, STA_BSY, 30 * 1000))
+    return false;
+  return (inb (reg_alt_status (c)) & STA_DRQ) != 0;
 }
 
 /* Program D's channel so that D is now the selected disk. */
@@ -529,23 +983,34 @@ select_device (const struct disk *d)
 {
   struct channel *c = d->channel;
   uint8_t dev = DEV_MBS;
+  int i;
+
   if (d->dev_no == 1)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
-  inb (reg_alt_status (c));
-  timer_nsleep (400);
+  c->selected = d;
+
+  /* The device needs 400 ns to respond.  Each read of the
+     alternate status register takes at least 100 ns, so this
+     waits long enough without calibrated delay loops. */
+  for (i = 0; i < 4; i++)
+    inb (reg_alt_status (c));
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
-   the channel to become idle before and after. */
+   the channel to become idle before and after.  If D is already
+   selected, only waits for the channel to become idle. */
 static void
 select_device_wait (const struct disk *d) 
 {
   wait_until_idle (d);
-  select_device (d);
-  wait_until_idle (d);
+  if (d->channel->selected != d) 
+    {
+      select_device (d);
+      wait_until_idle (d);
+    }
 }
-
+
 /* ATA interrupt handler. */
 static void
 interrupt_handler (struct intr_frame *f) 
@@ -557,7 +1022,7 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
-            inb (reg_status (c));               /* Acknowledge interrupt. */
+            c->status = inb (reg_status (c));   /* Acknowledge interrupt. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
@@ -17,8 +17,12 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+/* Queue buffer size, in bytes.  Large enough for the serial
+   transmit queue to absorb bursts of console output.  May be
+   overridden at build time, e.g. with DEFINES += -DINTQ_BUFSIZE=256. */
+#ifndef INTQ_BUFSIZE
+#define INTQ_BUFSIZE 1024
+#endif
 
 /* A circular queue of bytes. */
 struct intq
@@ -0,0 +1,92 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* The code in this file accesses PCI configuration space through
+   configuration mechanism #1, the pair of I/O ports that every
+   PC since the early PCI chipsets provides. */
+
+/* Configuration mechanism #1 ports. */
+#define CONFIG_ADDRESS 0xcf8    /* Selects a register (write). */
+#define CONFIG_DATA 0xcfc       /* Reads or writes the register. */
+
+/* CONFIG_ADDRESS bits. */
+#define CONFIG_ENABLE 0x80000000
+
+/* Selects register REG of the function at ADDR. */
+static void
+select_register (const struct pci_addr *addr, uint8_t reg) 
+{
+  ASSERT (addr->dev < 32 && addr->func < 8);
+  ASSERT (reg % 4 == 0);
+
+  outl (CONFIG_ADDRESS, (CONFIG_ENABLE | (addr->bus << 16) | (addr->dev << 11)
+                         | (addr->func << 8) | reg));
+}
+
+/* Returns the 32-bit configuration register REG of the function
+   at ADDR.  REG must be a multiple of 4. */
+uint32_t
+pci_read_config (const struct pci_addr *addr, uint8_t reg) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t value;
+
+  select_register (addr, reg);
+  value = inl (CONFIG_DATA);
+  intr_set_level (old_level);
+  return value;
+}
+
+/* Sets the 32-bit configuration register REG of the function at
+   ADDR to VALUE.  REG must be a multiple of 4. */
+void
+pci_write_config (const struct pci_addr *addr, uint8_t reg, uint32_t value) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  select_register (addr, reg);
+  outl (CONFIG_DATA, value);
+  intr_set_level (old_level);
+}
+
+/* Searches every PCI bus for the first function whose class and
+   subclass codes are CLASS and SUBCLASS.  If one is found,
+   stores its location in *ADDR and returns true; otherwise,
+   returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *addr) 
+{
+  int bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++) 
+        {
+          uint32_t class_reg;
+
+          addr->bus = bus;
+          addr->dev = dev;
+          addr->func = func;
+          if ((pci_read_config (addr, PCI_REG_ID) & 0xffff) == 0xffff) 
+            {
+              /* No device, or no function here.  Function 0 must
+                 exist for the others to. */
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class_reg = pci_read_config (addr, PCI_REG_CLASS);
+          if ((class_reg >> 24) == class
+              && ((class_reg >> 16) & 0xff) == subclass)
+            return true;
+
+          /* Only multifunction devices have functions past 0. */
+          if (func == 0
+              && !(pci_read_config (addr, PCI_REG_HEADER) & 0x800000))
+            break;
+        }
+  return false;
+}
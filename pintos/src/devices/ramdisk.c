@@ -0,0 +1,76 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in memory, one page per SECTORS_PER_PAGE
+   sectors, so that a large RAM disk need not be physically
+   contiguous.  Requests complete as soon as they are submitted,
+   which makes it useful for measuring file system code without
+   the timing of an emulated disk. */
+
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Pages holding the RAM disk's contents. */
+static uint8_t **pages;
+
+static void ramdisk_submit (void *, struct block_request *);
+
+/* Block device operations for the RAM disk. */
+static const struct block_operations ramdisk_operations =
+  {
+    ramdisk_submit,
+  };
+
+/* Creates a zeroed RAM disk of KB kilobytes, named "ram0", and
+   makes it the file system device. */
+void
+ramdisk_init (size_t kb)
+{
+  disk_sector_t size = kb * (1024 / DISK_SECTOR_SIZE);
+  size_t page_cnt = DIV_ROUND_UP (size, SECTORS_PER_PAGE);
+  size_t i;
+
+  ASSERT (size > 0);
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ram0: not enough memory for %zu kB RAM disk", kb);
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ram0: not enough memory for %zu kB RAM disk", kb);
+    }
+
+  printf ("ram0: %zu kB RAM disk\n", kb);
+  block_set_role (BLOCK_FILESYS,
+                  block_register ("ram0", size, &ramdisk_operations, NULL));
+}
+
+/* Does request R at once and completes it. */
+static void
+ramdisk_submit (void *aux UNUSED, struct block_request *r)
+{
+  uint8_t *buffer = r->buffer;
+  size_t i;
+
+  for (i = 0; i < r->cnt; i++)
+    {
+      disk_sector_t sec_no = r->sec_no + i;
+      uint8_t *sector = (pages[sec_no / SECTORS_PER_PAGE]
+                         + sec_no % SECTORS_PER_PAGE * DISK_SECTOR_SIZE);
+
+      if (r->write)
+        memcpy (sector, buffer, DISK_SECTOR_SIZE);
+      else
+        memcpy (buffer, sector, DISK_SECTOR_SIZE);
+      buffer += DISK_SECTOR_SIZE;
+    }
+  block_complete (r);
+}
@@ -1,5 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <stdio.h>
 #include "devices/input.h"
 #include "devices/intq.h"
 #include "devices/timer.h"
@@ -37,6 +38,18 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* FIFOs enabled (both bits set). */
+
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Clear receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Clear transmit FIFO. */
+#define FCR_TRIGGER_8 0x80      /* Receive interrupt at 8 bytes. */
+
+/* Size of each of the 16550A's FIFOs, in bytes. */
+#define FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -54,8 +67,20 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Current contents of the interrupt enable register. */
+static uint8_t ier;
+
+/* Bytes that may be written to the transmitter when it is empty:
+   FIFO_SIZE if the UART has working FIFOs, otherwise 1. */
+static size_t xmit_burst;
+
+/* Statistics. */
+static long long intr_cnt;      /* Number of serial interrupts. */
+static long long xmit_cnt;      /* Bytes sent from interrupt handler. */
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void flush_poll (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +93,16 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, (FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT
+                  | FCR_TRIGGER_8));    /* Enable and clear FIFOs. */
   set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
   intq_init (&txq);
+
+  /* Older UARTs, such as the 16450, have no FIFOs, and the
+     original 16550's are unreliable.  Either way, IIR does not
+     report FIFOs as enabled. */
+  xmit_burst = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? FIFO_SIZE : 1;
   mode = POLL;
 } 
 
@@ -98,31 +129,54 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Equivalent to
+   calling serial_putc() for each byte, but interrupts are
+   disabled and the interrupt enable register is updated once for
+   the whole buffer, unless the transmit queue fills up. */
+void
+serial_putbuf (const void *buffer_, size_t n) 
+{
+  const uint8_t *buffer = buffer_;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*buffer++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* Otherwise, queue the bytes and update the interrupt
+         enable register. */
+      while (n-- > 0) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (intq_full (&txq)) 
+            {
+              if (old_level == INTR_OFF)
+                {
+                  /* Interrupts are off and the transmit queue is
+                     full.  If we wanted to wait for the queue to
+                     empty, we'd have to reenable interrupts.
+                     That's impolite, so we'll send characters
+                     via polling instead. */
+                  flush_poll (); 
+                }
+              else
+                {
+                  /* intq_putc() will wait for the transmit
+                     interrupt to make room. */
+                  write_ier ();
+                }
+            }
+          intq_putc (&txq, *buffer++); 
         }
-
-      intq_putc (&txq, byte); 
       write_ier ();
     }
   
@@ -136,10 +190,18 @@ serial_flush (void)
 {
   enum intr_level old_level = intr_disable ();
   while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+    flush_poll ();
   intr_set_level (old_level);
 }
 
+/* Prints serial port statistics. */
+void
+serial_print_stats (void) 
+{
+  printf ("Serial: %lld interrupts, %lld bytes sent by interrupt\n",
+          intr_cnt, xmit_cnt);
+}
+
 /* The fullness of the input buffer may have changed.  Reassess
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
@@ -172,25 +234,30 @@ set_serial (int bps)
   outb (LCR_REG, LCR_N81);
 }
 
-/* Update interrupt enable register. */
+/* Update interrupt enable register.  Skips the write, which is
+   slow under emulation, if the register would not change. */
 static void
 write_ier (void) 
 {
-  uint8_t ier = 0;
+  uint8_t new_ier = 0;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
   if (!intq_empty (&txq))
-    ier |= IER_XMIT;
+    new_ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
      characters we receive. */
   if (!input_full ())
-    ier |= IER_RECV;
+    new_ier |= IER_RECV;
   
-  outb (IER_REG, ier);
+  if (new_ier != ier) 
+    {
+      ier = new_ier;
+      outb (IER_REG, ier);
+    }
 }
 
 /* Polls the serial port until it's ready,
@@ -205,23 +272,49 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Polls the serial port until it's ready, and then transmits as
+   many bytes from the transmit queue as it will take at once. */
+static void
+flush_poll (void) 
+{
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while ((inb (LSR_REG) & LSR_THRE) == 0)
+    continue;
+  for (i = 0; i < xmit_burst && !intq_empty (&txq); i++)
+    outb (THR_REG, intq_getc (&txq));
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
 {
+  size_t i;
+
+  intr_cnt++;
+
   /* Inquire about interrupt in UART.  Without this, we can
      occasionally miss an interrupt running under QEMU. */
   inb (IIR_REG);
 
   /* As long as we have room to receive a byte, and the hardware
-     has a byte for us, receive a byte.  */
+     has a byte for us, receive a byte.  The receive interrupt
+     comes once the FIFO holds 8 bytes, or when bytes have sat in
+     it for a while, so this usually drains several at once. */
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmitter is empty, refill it with as many bytes as
+     its FIFO holds.  THRE is not set again until the FIFO has
+     drained, so there is no point in checking it in between. */
+  if (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
+    for (i = 0; i < xmit_burst && !intq_empty (&txq); i++) 
+      {
+        outb (THR_REG, intq_getc (&txq));
+        xmit_cnt++;
+      }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
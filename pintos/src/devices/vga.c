@@ -25,6 +25,7 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+static void putc_at_cursor (int c);
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
@@ -49,13 +50,36 @@ init (void)
    characters in the conventional ways.  */
 void
 vga_putc (int c)
+{
+  char ch = c;
+  vga_putbuf (&ch, 1);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, as
+   vga_putc() would, but moves the hardware cursor only once at
+   the end. */
+void
+vga_putbuf (const char *buffer, size_t n) 
 {
   /* Disable interrupts to lock out interrupt handlers
      that might write to the console. */
   enum intr_level old_level = intr_disable ();
 
   init ();
-  
+  while (n-- > 0)
+    putc_at_cursor (*buffer++);
+
+  /* Update cursor position. */
+  move_cursor ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes C at the cursor position, without moving the hardware
+   cursor. */
+static void
+putc_at_cursor (int c) 
+{
   switch (c) 
     {
     case '\n':
@@ -88,11 +112,6 @@ vga_putc (int c)
         newline ();
       break;
     }
-
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
 }
 
 /* Clears the screen and moves the cursor to the upper left. */
@@ -1,6 +1,7 @@
 /* cat.c
 
-   Compares two files. */
+   Compares two files, reading both at the same offset with
+   pread. */
 
 #include <stdio.h>
 #include <syscall.h>
@@ -8,7 +9,9 @@
 int
 main (int argc, char *argv[]) 
 {
+  static char buffer[2][4096];
   int fd[2];
+  int pos;
 
   if (argc != 3) 
     {
@@ -31,19 +34,16 @@ main (int argc, char *argv[])
     }
 
   /* Compare data. */
-  for (;;) 
+  for (pos = 0; ; pos += sizeof buffer[0]) 
     {
-      int pos;
-      char buffer[2][1024];
       int bytes_read[2];
       int min_read;
       int i;
 
-      pos = tell (fd[0]);
-      bytes_read[0] = read (fd[0], buffer[0], sizeof buffer[0]);
-      bytes_read[1] = read (fd[1], buffer[1], sizeof buffer[1]);
+      bytes_read[0] = pread (fd[0], buffer[0], sizeof buffer[0], pos);
+      bytes_read[1] = pread (fd[1], buffer[1], sizeof buffer[1], pos);
       min_read = bytes_read[0] < bytes_read[1] ? bytes_read[0] : bytes_read[1];
-      if (min_read == 0)
+      if (min_read <= 0)
         break;
 
       for (i = 0; i < min_read; i++)
@@ -0,0 +1,35 @@
+/* conbench.c
+
+   Writes 1 MB to the console, in 80-character lines, for
+   measuring console throughput.  Run it with `pintos -q run
+   conbench' and compare the statistics that the kernel prints
+   when it powers off: the characters per second is the
+   "Console:" character count divided by the "Timer:" tick count,
+   times the timer frequency (100 Hz by default). */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Bytes to write. */
+#define TOTAL_BYTES (1024 * 1024)
+
+/* Bytes per write() call: a few lines at a time, as a program
+   producing log output with stdio would. */
+#define CHUNK 1040
+
+int
+main (void)
+{
+  static char buf[CHUNK];
+  size_t i, written;
+
+  /* 13 lines of 79 printable characters and a new-line. */
+  for (i = 0; i < CHUNK; i++)
+    buf[i] = i % 80 == 79 ? '\n' : ' ' + i % 80;
+
+  for (written = 0; written < TOTAL_BYTES; written += CHUNK)
+    write (STDOUT_FILENO, buf, CHUNK);
+
+  return EXIT_SUCCESS;
+}
@@ -1,23 +1,27 @@
 /* mcp.c
 
-   Copies one file to another, using mmap. */
+   Copies one file to another, moving several buffers per system
+   call with readv and writev. */
 
 #include <stdio.h>
 #include <string.h>
 #include <syscall.h>
 
+/* Number of buffers moved per call, and size of each. */
+#define SEG_CNT 8
+#define SEG_SIZE 512
+
 int
 main (int argc, char *argv[]) 
 {
+  static char buffers[SEG_CNT][SEG_SIZE];
+  struct iovec iov[SEG_CNT];
   int in_fd, out_fd;
-  mapid_t in_map, out_map;
-  void *in_data = (void *) 0x10000000;
-  void *out_data = (void *) 0x20000000;
-  int size;
+  int size, i;
 
   if (argc != 3) 
     {
-      printf ("usage: cp OLD NEW\n");
+      printf ("usage: mcp OLD NEW\n");
       return EXIT_FAILURE;
     }
 
@@ -43,26 +47,34 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Map files. */
-  in_map = mmap (in_fd, in_data);
-  if (in_map == MAP_FAILED) 
+  /* Copy files. */
+  for (i = 0; i < SEG_CNT; i++) 
     {
-      printf ("%s: mmap failed\n", argv[1]);
-      return EXIT_FAILURE;
+      iov[i].iov_base = buffers[i];
+      iov[i].iov_len = SEG_SIZE;
     }
-  out_map = mmap (out_fd, out_data);
-  if (out_map == MAP_FAILED)
+  for (;;) 
     {
-      printf ("%s: mmap failed\n", argv[2]);
-      return EXIT_FAILURE;
-    }
+      int bytes_read = readv (in_fd, iov, SEG_CNT);
+      int bytes_left = bytes_read;
 
-  /* Copy files. */
-  memcpy (out_data, in_data, size);
+      if (bytes_read <= 0)
+        break;
 
-  /* Unmap files (optional). */
-  munmap (in_map);
-  munmap (out_map);
+      /* Trim the vector to what was read. */
+      for (i = 0; i < SEG_CNT; i++) 
+        {
+          iov[i].iov_len = bytes_left < SEG_SIZE ? bytes_left : SEG_SIZE;
+          bytes_left -= iov[i].iov_len;
+        }
+      if (writev (out_fd, iov, SEG_CNT) != bytes_read) 
+        {
+          printf ("%s: write failed\n", argv[2]);
+          return EXIT_FAILURE;
+        }
+      for (i = 0; i < SEG_CNT; i++)
+        iov[i].iov_len = SEG_SIZE;
+    }
 
   return EXIT_SUCCESS;
 }
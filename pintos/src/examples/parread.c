@@ -0,0 +1,116 @@
+/* parread.c
+
+   Measures how file system reads scale with the number of
+   processes doing them.  `parread N' creates N files, then runs
+   N copies of itself at once, each of which reads its own file
+   several times over.  Every child does the same amount of work,
+   so if reads in different files proceed in parallel, the run
+   time grows much more slowly than N.
+
+   Run it with, for example, `pintos -q run "parread 1"' and then
+   with 2, 4, and 8, and compare the "Timer:" tick counts that the
+   kernel prints when it powers off. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Maximum number of children. */
+#define MAX_CHILDREN 16
+
+/* Size of each child's file, and number of times it is read. */
+#define FILE_SIZE (32 * 1024)
+#define PASS_CNT 8
+
+static char buf[512];
+
+static int child (int idx);
+
+int
+main (int argc, char *argv[])
+{
+  pid_t children[MAX_CHILDREN];
+  char name[16], cmd[32];
+  int child_cnt;
+  int i, fd;
+
+  if (argc == 3 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]));
+  if (argc != 2 || (child_cnt = atoi (argv[1])) < 1
+      || child_cnt > MAX_CHILDREN)
+    {
+      printf ("usage: parread N, where 1 <= N <= %d\n", MAX_CHILDREN);
+      return EXIT_FAILURE;
+    }
+
+  /* Create one file per child, filled with the child's number. */
+  memset (buf, 0, sizeof buf);
+  for (i = 0; i < child_cnt; i++)
+    {
+      size_t ofs;
+
+      snprintf (name, sizeof name, "parread%d", i);
+      if (!create (name, 0) || (fd = open (name)) < 0)
+        {
+          printf ("%s: create failed\n", name);
+          return EXIT_FAILURE;
+        }
+      memset (buf, i, sizeof buf);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+        write (fd, buf, sizeof buf);
+      close (fd);
+    }
+
+  /* Run the children and wait for all of them. */
+  for (i = 0; i < child_cnt; i++)
+    {
+      snprintf (cmd, sizeof cmd, "parread -c %d", i);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("%s: exec failed\n", cmd);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < child_cnt; i++)
+    if (wait (children[i]) != 0)
+      printf ("parread: child %d failed\n", i);
+
+  printf ("parread: %d children read %d kB each\n",
+          child_cnt, FILE_SIZE / 1024 * PASS_CNT);
+  return EXIT_SUCCESS;
+}
+
+/* Reads file number IDX from start to end PASS_CNT times, one
+   sector-sized block at a time, and checks its contents.
+   Returns 0 if successful, otherwise 1. */
+static int
+child (int idx)
+{
+  char name[16];
+  int pass, fd;
+
+  snprintf (name, sizeof name, "parread%d", idx);
+  fd = open (name);
+  if (fd < 0)
+    return EXIT_FAILURE;
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      size_t ofs;
+
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+        {
+          size_t i;
+
+          if (read (fd, buf, sizeof buf) != sizeof buf)
+            return EXIT_FAILURE;
+          for (i = 0; i < sizeof buf; i++)
+            if (buf[i] != (char) idx)
+              return EXIT_FAILURE;
+        }
+    }
+  close (fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,578 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of sectors held in the cache. */
+#define CACHE_SIZE 64
+
+/* Ticks between write-behind passes. */
+#define WRITE_BEHIND_TICKS TIMER_FREQ
+
+/* Maximum number of pending read-ahead requests.  Requests
+   beyond this are dropped. */
+#define READ_AHEAD_MAX 16
+
+/* Maximum number of sectors read by one call to fetch(). */
+#define FETCH_MAX 16
+
+/* A cached disk sector.
+
+   An entry is "pinned" while a thread is using it or waiting to
+   use it; pinned entries are never evicted, so SECTOR is stable
+   for as long as the pin is held.  A "held" entry belongs to an
+   uncommitted journal transaction: it is neither evicted nor
+   written back until cache_unhold().  DATA, DIRTY, and IO are
+   protected by LOCK, everything else by cache_lock. */
+struct cache_entry
+  {
+    disk_sector_t sector;               /* Sector held, if IN_USE. */
+    bool in_use;                        /* True if SECTOR is valid. */
+    bool accessed;                      /* Used since last clock sweep? */
+    int pin_cnt;                        /* Users and waiters. */
+    bool held;                          /* Held by the journal? */
+    bool writing_back;                  /* Being evicted from OLD_SECTOR? */
+    disk_sector_t old_sector;           /* Sector being written back. */
+    struct lock lock;                   /* Protects DATA and DIRTY. */
+    bool dirty;                         /* DATA newer than disk? */
+    struct block_request io;            /* Asynchronous I/O on DATA. */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+
+/* Protects the cache table and the read-ahead queue. */
+static struct lock cache_lock;
+
+/* Signaled when an entry is unpinned or finishes write-back. */
+static struct condition cache_cond;
+
+/* Clock hand for replacement. */
+static size_t clock_hand;
+
+/* Ring of sectors waiting to be read ahead. */
+static disk_sector_t read_ahead_queue[READ_AHEAD_MAX];
+static size_t read_ahead_head;
+static size_t read_ahead_cnt;
+static struct semaphore read_ahead_sema;
+
+static struct cache_entry *lookup (disk_sector_t);
+static bool is_writing_back (disk_sector_t);
+static struct cache_entry *choose_victim (void);
+static void claim (struct cache_entry *, disk_sector_t);
+static void finish_claim (struct cache_entry *);
+static void submit_io (struct cache_entry *, bool write);
+static void fetch (const disk_sector_t *, size_t cnt);
+static struct cache_entry *cache_get (disk_sector_t, bool load);
+static void cache_release (struct cache_entry *, bool dirty);
+static thread_func write_behind_daemon NO_RETURN;
+static thread_func read_ahead_daemon NO_RETURN;
+
+/* Initializes the buffer cache and starts its write-behind and
+   read-ahead threads. */
+void
+cache_init (void) 
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&cache_cond);
+  sema_init (&read_ahead_sema, 0);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].in_use = false;
+      cache[i].pin_cnt = 0;
+      cache[i].held = false;
+      cache[i].writing_back = false;
+      cache[i].dirty = false;
+      lock_init (&cache[i].lock);
+    }
+
+  thread_create ("write-behind", PRI_DEFAULT, write_behind_daemon, NULL);
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+}
+
+/* Writes every dirty sector in the cache to disk, except for
+   sectors held by the journal.  All of the writes are queued to
+   the disk at once, so that the disk driver can order them and
+   merge runs of consecutive sectors into single commands. */
+void
+cache_flush (void) 
+{
+  disk_sector_t sectors[CACHE_SIZE];
+  struct cache_entry *writing[CACHE_SIZE];
+  size_t sector_cnt, writing_cnt;
+  size_t i, j;
+
+  /* Gather the dirty sectors in ascending order.  DIRTY is only a
+     hint here; it is checked again under each entry's own
+     lock. */
+  lock_acquire (&cache_lock);
+  sector_cnt = 0;
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].dirty && !cache[i].held) 
+      {
+        for (j = sector_cnt++; j > 0 && sectors[j - 1] > cache[i].sector; j--)
+          sectors[j] = sectors[j - 1];
+        sectors[j] = cache[i].sector;
+      }
+  lock_release (&cache_lock);
+
+  /* Lock each entry and queue its write.  Entries are always
+     locked in ascending sector order, so concurrent flushes
+     cannot deadlock. */
+  writing_cnt = 0;
+  for (i = 0; i < sector_cnt; i++) 
+    {
+      struct cache_entry *e;
+
+      lock_acquire (&cache_lock);
+      e = lookup (sectors[i]);
+      if (e == NULL || e->held) 
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (!e->dirty) 
+        {
+          cache_release (e, false);
+          continue;
+        }
+      submit_io (e, true);
+      writing[writing_cnt++] = e;
+    }
+
+  for (i = 0; i < writing_cnt; i++) 
+    {
+      block_wait (&writing[i]->io);
+      writing[i]->dirty = false;
+      cache_release (writing[i], false);
+    }
+}
+
+/* Makes sure that each of the CNT SECTORS, which must be
+   distinct, is on disk: writes those that are cached and dirty,
+   queuing all of the writes before waiting for any, and waits
+   for any that are being written back after eviction.  Sectors
+   held by the journal are skipped.  Sorts SECTORS. */
+void
+cache_write_back (disk_sector_t *sectors, size_t cnt) 
+{
+  struct cache_entry *writing[CACHE_SIZE];
+  size_t writing_cnt;
+  size_t i, j;
+
+  /* Entries are locked in ascending sector order, as in
+     cache_flush(). */
+  for (i = 1; i < cnt; i++) 
+    {
+      disk_sector_t sector = sectors[i];
+      for (j = i; j > 0 && sectors[j - 1] > sector; j--)
+        sectors[j] = sectors[j - 1];
+      sectors[j] = sector;
+    }
+
+  writing_cnt = 0;
+  for (i = 0; i < cnt; i++) 
+    {
+      struct cache_entry *e;
+
+      lock_acquire (&cache_lock);
+      while (is_writing_back (sectors[i]))
+        cond_wait (&cache_cond, &cache_lock);
+      e = lookup (sectors[i]);
+      if (e == NULL || e->held) 
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (!e->dirty) 
+        {
+          cache_release (e, false);
+          continue;
+        }
+      submit_io (e, true);
+      writing[writing_cnt++] = e;
+    }
+
+  for (i = 0; i < writing_cnt; i++) 
+    {
+      block_wait (&writing[i]->io);
+      writing[i]->dirty = false;
+      cache_release (writing[i], false);
+    }
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_read (disk_sector_t sector, void *buffer) 
+{
+  cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (disk_sector_t sector, void *buffer, int ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_release (e, false);
+}
+
+/* Writes sector SECTOR from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  The write reaches the disk later. */
+void
+cache_write (disk_sector_t sector, const void *buffer) 
+{
+  cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER into sector SECTOR starting at
+   byte offset OFS.  The write reaches the disk later. */
+void
+cache_write_at (disk_sector_t sector, const void *buffer, int ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  /* A whole-sector write need not read the old contents. */
+  e = cache_get (sector, size < DISK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  cache_release (e, true);
+}
+
+/* Brings SECTOR into the cache, if it is not there already, and
+   keeps it there, unwritten, until cache_unhold() is called for
+   it.  If LOAD is false, the caller is about to overwrite all of
+   SECTOR, so it is not read from disk. */
+void
+cache_hold (disk_sector_t sector, bool load) 
+{
+  struct cache_entry *e = cache_get (sector, load);
+
+  lock_acquire (&cache_lock);
+  e->held = true;
+  lock_release (&cache_lock);
+  cache_release (e, false);
+}
+
+/* Writes SECTOR, which must be held by cache_hold(), to disk if
+   it is dirty, and lets it be evicted again. */
+void
+cache_unhold (disk_sector_t sector) 
+{
+  struct cache_entry *e = cache_get (sector, true);
+
+  ASSERT (e->held);
+  if (e->dirty) 
+    {
+      block_write (filesys_disk, e->sector, e->data);
+      e->dirty = false;
+    }
+  lock_acquire (&cache_lock);
+  e->held = false;
+  lock_release (&cache_lock);
+  cache_release (e, false);
+}
+
+/* Reads the CNT sectors starting at FIRST into the cache, in
+   expectation of reads of them soon.  The reads are queued to
+   the disk together, so that runs of consecutive sectors are
+   read with single commands.  Sectors that are cached, on their
+   way out of the cache, or for which no entry can be found
+   without waiting are skipped. */
+void
+cache_prefetch (disk_sector_t first, size_t cnt) 
+{
+  while (cnt > 0) 
+    {
+      disk_sector_t sectors[FETCH_MAX];
+      size_t n;
+
+      for (n = 0; n < cnt && n < FETCH_MAX; n++)
+        sectors[n] = first + n;
+      fetch (sectors, n);
+      first += n;
+      cnt -= n;
+    }
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   in expectation of a read of it soon.  Does nothing if SECTOR
+   is already cached or too many requests are pending. */
+void
+cache_read_ahead (disk_sector_t sector) 
+{
+  bool queued = false;
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      break;
+  if (i == CACHE_SIZE && read_ahead_cnt < READ_AHEAD_MAX)
+    {
+      read_ahead_queue[(read_ahead_head + read_ahead_cnt++)
+                       % READ_AHEAD_MAX] = sector;
+      queued = true;
+    }
+  lock_release (&cache_lock);
+
+  if (queued)
+    sema_up (&read_ahead_sema);
+}
+
+/* Returns the entry in use for SECTOR, or a null pointer if
+   there is none.  The caller must hold cache_lock. */
+static struct cache_entry *
+lookup (disk_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Returns true if an entry is still writing SECTOR back to disk
+   after being evicted.  The caller must hold cache_lock. */
+static bool
+is_writing_back (disk_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].writing_back && cache[i].old_sector == sector)
+      return true;
+  return false;
+}
+
+/* Picks an entry to replace using the clock algorithm, or
+   returns a null pointer if every entry is pinned.  The caller
+   must hold cache_lock. */
+static struct cache_entry *
+choose_victim (void) 
+{
+  size_t i;
+
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (e->pin_cnt > 0 || e->held)
+        continue;
+      if (!e->in_use || !e->accessed)
+        return e;
+      e->accessed = false;
+    }
+  return NULL;
+}
+
+/* Takes over unpinned entry E for SECTOR, leaving it pinned and
+   locked.  E was unpinned, so nobody holds or waits for its lock
+   and acquiring it here cannot block.  The caller must hold
+   cache_lock and, after releasing it, call finish_claim() before
+   filling in E's data. */
+static void
+claim (struct cache_entry *e, disk_sector_t sector) 
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (e->pin_cnt == 0 && !e->held);
+
+  e->pin_cnt++;
+  lock_acquire (&e->lock);
+  e->writing_back = e->in_use && e->dirty;
+  e->old_sector = e->sector;
+  e->sector = sector;
+  e->in_use = true;
+  e->accessed = true;
+}
+
+/* Writes back the sector that E held before claim(), if it was
+   dirty.  Lookups of E's new sector find E and wait on its lock
+   in the meantime. */
+static void
+finish_claim (struct cache_entry *e) 
+{
+  if (e->writing_back) 
+    {
+      block_write (filesys_disk, e->old_sector, e->data);
+      lock_acquire (&cache_lock);
+      e->writing_back = false;
+      cond_broadcast (&cache_cond, &cache_lock);
+      lock_release (&cache_lock);
+    }
+  e->dirty = false;
+}
+
+/* Queues a disk request to read E's sector into E's data, or to
+   write E's data to its sector if WRITE is true.  The caller
+   must hold E's lock until it has called block_wait() on E's
+   request. */
+static void
+submit_io (struct cache_entry *e, bool write) 
+{
+  e->io.sec_no = e->sector;
+  e->io.cnt = 1;
+  e->io.buffer = e->data;
+  e->io.write = write;
+  e->io.func = NULL;
+  block_submit (filesys_disk, &e->io);
+}
+
+/* Reads those of the CNT SECTORS that are not cached into the
+   cache, queuing all of the reads before waiting for any.  CNT
+   must not exceed FETCH_MAX.  Skips the same sectors as
+   cache_prefetch(). */
+static void
+fetch (const disk_sector_t *sectors, size_t cnt) 
+{
+  struct cache_entry *claimed[FETCH_MAX];
+  size_t claimed_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= FETCH_MAX);
+
+  /* Claim an entry for each sector.  The entries are new to the
+     cache, so nobody else holds their locks, and we never wait
+     for another entry's lock while holding them. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++) 
+    {
+      struct cache_entry *e;
+
+      if (lookup (sectors[i]) != NULL || is_writing_back (sectors[i]))
+        continue;
+      e = choose_victim ();
+      if (e == NULL)
+        break;
+      claim (e, sectors[i]);
+      claimed[claimed_cnt++] = e;
+    }
+  lock_release (&cache_lock);
+
+  for (i = 0; i < claimed_cnt; i++) 
+    {
+      finish_claim (claimed[i]);
+      submit_io (claimed[i], false);
+    }
+  for (i = 0; i < claimed_cnt; i++) 
+    {
+      block_wait (&claimed[i]->io);
+      cache_release (claimed[i], false);
+    }
+}
+
+/* Returns the cache entry for SECTOR, pinned and with its lock
+   held, evicting another sector if necessary.  If LOAD is true,
+   a newly cached sector is read from disk; otherwise the caller
+   must overwrite all of it. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool load) 
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = lookup (sector);
+      if (e != NULL) 
+        {
+          e->pin_cnt++;
+          e->accessed = true;
+          lock_release (&cache_lock);
+          lock_acquire (&e->lock);
+          return e;
+        }
+
+      /* An old copy of SECTOR may still be on its way out to
+         disk; reading it now would return stale data. */
+      if (!is_writing_back (sector)) 
+        {
+          e = choose_victim ();
+          if (e != NULL)
+            break;
+        }
+      cond_wait (&cache_cond, &cache_lock);
+    }
+  claim (e, sector);
+  lock_release (&cache_lock);
+
+  finish_claim (e);
+  if (load)
+    block_read (filesys_disk, sector, e->data);
+  return e;
+}
+
+/* Unlocks and unpins E, obtained from cache_get().  DIRTY
+   should be true if E's data was modified. */
+static void
+cache_release (struct cache_entry *e, bool dirty) 
+{
+  if (dirty)
+    e->dirty = true;
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  if (--e->pin_cnt == 0)
+    cond_broadcast (&cache_cond, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Periodically writes dirty sectors back to disk, so that a
+   crash loses at most a few seconds of writes. */
+static void
+write_behind_daemon (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (WRITE_BEHIND_TICKS);
+      cache_flush ();
+    }
+}
+
+/* Reads sectors queued by cache_read_ahead() into the cache. */
+static void
+read_ahead_daemon (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      disk_sector_t sectors[READ_AHEAD_MAX];
+      size_t cnt = 0;
+
+      /* Take every pending request, so that they reach the disk
+         together. */
+      sema_down (&read_ahead_sema);
+      lock_acquire (&cache_lock);
+      do
+        {
+          sectors[cnt++] = read_ahead_queue[read_ahead_head];
+          read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_MAX;
+          read_ahead_cnt--;
+        }
+      while (read_ahead_cnt > 0 && sema_try_down (&read_ahead_sema));
+      lock_release (&cache_lock);
+
+      fetch (sectors, cnt);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+void cache_init (void);
+void cache_flush (void);
+void cache_write_back (disk_sector_t *, size_t cnt);
+void cache_read (disk_sector_t, void *);
+void cache_read_at (disk_sector_t, void *, int ofs, int size);
+void cache_write (disk_sector_t, const void *);
+void cache_write_at (disk_sector_t, const void *, int ofs, int size);
+void cache_read_ahead (disk_sector_t);
+void cache_prefetch (disk_sector_t first, size_t cnt);
+void cache_hold (disk_sector_t, bool load);
+void cache_unhold (disk_sector_t);
+
+#endif /* filesys/cache.h */
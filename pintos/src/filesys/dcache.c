@@ -0,0 +1,216 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+
+/* Number of name lookups remembered. */
+#define DCACHE_SIZE 256
+
+/* The result of looking up NAME in the directory whose inode is
+   in sector DIR.
+
+   SECTOR is 0 for a negative entry, recording that DIR has no
+   entry NAME.  Sector 0 holds the free map inode, which is never
+   named in a directory, so it cannot be a real result.
+
+   Entries are added only by dir_lookup(), and invalidated by
+   dir_add() and dir_remove(), all while holding DIR's directory
+   lock, so an entry never outlives the directory contents it
+   describes. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in `dentries'. */
+    struct list_elem list_elem;         /* Element in `lru' or `free'. */
+    disk_sector_t dir;                  /* Directory searched. */
+    char name[NAME_MAX + 1];            /* Name searched for. */
+    disk_sector_t sector;               /* Inode found, or 0. */
+    bool is_dir;                        /* Is SECTOR a directory? */
+  };
+
+static struct dentry dentry_pool[DCACHE_SIZE];
+static struct hash dentries;            /* Entries in use, by DIR and NAME. */
+static struct list lru;                 /* Entries in use, most recent first. */
+static struct list free_dentries;       /* Entries not in use. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *find (disk_sector_t dir, const char *name);
+static void discard (struct dentry *);
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void) 
+{
+  size_t i;
+
+  if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+    PANIC ("dentry cache creation failed");
+  list_init (&lru);
+  list_init (&free_dentries);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&free_dentries, &dentry_pool[i].list_elem);
+  lock_init (&dcache_lock);
+}
+
+/* Looks up NAME in directory DIR in the cache.  If it is cached,
+   returns true and sets *SECTORP and *IS_DIRP to the result, with
+   *SECTORP set to 0 if DIR is known to have no entry NAME.
+   Returns false if the directory must be searched. */
+bool
+dcache_lookup (disk_sector_t dir, const char *name,
+               disk_sector_t *sectorp, bool *is_dirp) 
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->list_elem);
+      list_push_front (&lru, &d->list_elem);
+      *sectorp = d->sector;
+      *is_dirp = d->is_dir;
+    }
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Looks up NAME in directory DIR in the cache and sets *CACHEDP
+   to whether it was found there.  If it was, returns NAME's
+   inode, opened while the entry is known to be current so that
+   the file cannot be deleted in between, or a null pointer if
+   DIR has no entry NAME. */
+struct inode *
+dcache_open (disk_sector_t dir, const char *name, bool *cachedp) 
+{
+  struct inode *inode = NULL;
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->list_elem);
+      list_push_front (&lru, &d->list_elem);
+      if (d->sector != 0)
+        inode = inode_open (d->sector);
+    }
+  lock_release (&dcache_lock);
+
+  *cachedp = d != NULL;
+  return inode;
+}
+
+/* Records that NAME in directory DIR is the inode in SECTOR, a
+   directory if IS_DIR is true, or that DIR has no entry NAME if
+   SECTOR is 0.  The caller must hold DIR's directory lock. */
+void
+dcache_insert (disk_sector_t dir, const char *name,
+               disk_sector_t sector, bool is_dir) 
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    discard (d);
+  if (list_empty (&free_dentries))
+    discard (list_entry (list_back (&lru), struct dentry, list_elem));
+
+  d = list_entry (list_pop_front (&free_dentries), struct dentry, list_elem);
+  d->dir = dir;
+  strlcpy (d->name, name, sizeof d->name);
+  d->sector = sector;
+  d->is_dir = is_dir;
+  hash_insert (&dentries, &d->hash_elem);
+  list_push_front (&lru, &d->list_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets any cached lookup of NAME in DIR.  The caller must
+   hold DIR's directory lock. */
+void
+dcache_invalidate (disk_sector_t dir, const char *name) 
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    discard (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every cached lookup in DIR, which is being deleted.
+   The caller must hold DIR's directory lock. */
+void
+dcache_purge_dir (disk_sector_t dir) 
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  for (e = list_begin (&lru); e != list_end (&lru); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, list_elem);
+      next = list_next (e);
+      if (d->dir == dir)
+        discard (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns a hash value for dentry E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached entry for NAME in DIR, or a null pointer.
+   The caller must hold dcache_lock. */
+static struct dentry *
+find (disk_sector_t dir, const char *name) 
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and returns it to the free list.
+   The caller must hold dcache_lock. */
+static void
+discard (struct dentry *d) 
+{
+  hash_delete (&dentries, &d->hash_elem);
+  list_remove (&d->list_elem);
+  list_push_front (&free_dentries, &d->list_elem);
+}
@@ -0,0 +1,18 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+struct inode;
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t dir, const char *name,
+                    disk_sector_t *sectorp, bool *is_dirp);
+struct inode *dcache_open (disk_sector_t dir, const char *name, bool *cachedp);
+void dcache_insert (disk_sector_t dir, const char *name,
+                    disk_sector_t sector, bool is_dir);
+void dcache_invalidate (disk_sector_t dir, const char *name);
+void dcache_purge_dir (disk_sector_t dir);
+
+#endif /* filesys/dcache.h */
@@ -1,7 +1,9 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -22,12 +24,44 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* In-memory index of a directory's entries, built from the
+   directory file the first time it is searched and kept until
+   its inode is closed.  Protected by the inode's directory
+   lock.  The directory file itself, and hence dir_readdir()
+   order, is unaffected. */
+struct dir_index
+  {
+    struct hash entries;                /* Entries in use, by name. */
+    struct list free_slots;             /* Entries not in use. */
+    off_t end;                          /* Offset just past last entry. */
+  };
+
+/* A directory entry in a dir_index. */
+struct index_entry
+  {
+    union
+      {
+        struct hash_elem hash_elem;     /* In `entries', if in use. */
+        struct list_elem list_elem;     /* In `free_slots', if not. */
+      }
+    elem;
+    off_t ofs;                          /* Byte offset in directory. */
+    disk_sector_t inode_sector;         /* Sector number of header. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
+static struct dir_index *get_index (const struct dir *);
+static void discard_index (const struct dir *);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, as a subdirectory of the directory whose inode is
+   in sector PARENT.  Returns true if successful, false on
+   failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) 
+dir_create (disk_sector_t sector, size_t entry_cnt, disk_sector_t parent) 
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  return inode_create_dir (sector, entry_cnt * sizeof (struct dir_entry),
+                           parent);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -88,17 +122,46 @@ dir_get_inode (struct dir *dir)
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   The caller must hold DIR's directory lock. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  index = get_index (dir);
+  if (index != NULL) 
+    {
+      struct index_entry key;
+      struct hash_elem *he;
+
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_find (&index->entries, &key.elem.hash_elem);
+      if (he == NULL)
+        return false;
+      if (ep != NULL) 
+        {
+          struct index_entry *ie = hash_entry (he, struct index_entry,
+                                               elem.hash_elem);
+          ep->inode_sector = ie->inode_sector;
+          strlcpy (ep->name, ie->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = hash_entry (he, struct index_entry, elem.hash_elem)->ofs;
+      return true;
+    }
+
+  /* No memory for an index.  Scan the directory. */
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && !strcmp (name, e.name)) 
@@ -125,23 +188,100 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
+  inode_lock_dir (dir->inode);
+  if (inode_is_removed (dir->inode))
     *inode = NULL;
+  else 
+    {
+      disk_sector_t sector = inode_get_inumber (dir->inode);
+
+      if (!strcmp (name, "."))
+        *inode = inode_reopen (dir->inode);
+      else if (!strcmp (name, ".."))
+        *inode = inode_open (inode_get_parent (dir->inode));
+      else if (lookup (dir, name, &e, NULL))
+        *inode = inode_open (e.inode_sector);
+      else
+        {
+          *inode = NULL;
+          dcache_insert (sector, name, 0, false);
+        }
+      if (*inode != NULL)
+        dcache_insert (sector, name, inode_get_inumber (*inode),
+                       inode_is_dir (*inode));
+    }
+  inode_unlock_dir (dir->inode);
 
   return *inode != NULL;
 }
 
+/* Looks up NAME, which may be "." or "..", in the directory
+   whose inode is in sector DIR_SECTOR.  If it is found, returns
+   true and sets *SECTORP to its inode sector and *IS_DIRP to
+   whether it is a directory; otherwise returns false.  Answers
+   from the dentry cache when possible, in which case neither
+   directory nor entry is read. */
+bool
+dir_lookup_sector (disk_sector_t dir_sector, const char *name,
+                   disk_sector_t *sectorp, bool *is_dirp) 
+{
+  struct inode *inode;
+  struct dir *dir;
+  bool found;
+
+  if (dcache_lookup (dir_sector, name, sectorp, is_dirp))
+    return *sectorp != 0;
+
+  dir = dir_open (inode_open (dir_sector));
+  if (dir == NULL)
+    return false;
+  found = inode_is_dir (dir->inode) && dir_lookup (dir, name, &inode);
+  if (found) 
+    {
+      *sectorp = inode_get_inumber (inode);
+      *is_dirp = inode_is_dir (inode);
+      inode_close (inode);
+    }
+  dir_close (dir);
+  return found;
+}
+
+/* Opens and returns the inode for NAME, which may be "." or
+   "..", in the directory whose inode is in sector DIR_SECTOR, or
+   returns a null pointer if there is no such entry.  Answers
+   from the dentry cache when possible, in which case the
+   directory is not read. */
+struct inode *
+dir_open_entry (disk_sector_t dir_sector, const char *name) 
+{
+  struct inode *inode;
+  struct dir *dir;
+  bool cached;
+
+  inode = dcache_open (dir_sector, name, &cached);
+  if (cached)
+    return inode;
+
+  dir = dir_open (inode_open (dir_sector));
+  if (dir == NULL)
+    return NULL;
+  if (!inode_is_dir (dir->inode) || !dir_lookup (dir, name, &inode))
+    inode = NULL;
+  dir_close (dir);
+  return inode;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long, or "." or ".."), if
+   DIR has been removed, or if a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
 {
+  struct dir_index *index;
+  struct index_entry *ie = NULL;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -150,24 +290,46 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  if (*name == '\0' || strlen (name) > NAME_MAX
+      || !strcmp (name, ".") || !strcmp (name, ".."))
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  inode_lock_dir (dir->inode);
+
+  /* Check that DIR still exists and NAME is not in use. */
+  if (inode_is_removed (dir->inode) || lookup (dir, name, NULL, NULL))
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
 	
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+     current end-of-file. */
+  index = get_index (dir);
+  if (index != NULL) 
+    {
+      if (!list_empty (&index->free_slots))
+        ie = list_entry (list_pop_front (&index->free_slots),
+                         struct index_entry, elem.list_elem);
+      else 
+        {
+          ie = malloc (sizeof *ie);
+          if (ie == NULL)
+            goto done;
+          ie->ofs = index->end;
+        }
+      ofs = ie->ofs;
+    }
+  else
+    {
+      /* inode_read_at() will only return a short read at end of
+         file.  Otherwise, we'd need to verify that we didn't get
+         a short read due to something intermittent such as low
+         memory. */
+      for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+           ofs += sizeof e) 
+        if (!e.in_use)
+          break;
+    }
 
   /* Write slot. */
   e.in_use = true;
@@ -175,16 +337,52 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+  /* Update index. */
+  if (ie != NULL)
+    {
+      if (success) 
+        {
+          ie->inode_sector = inode_sector;
+          strlcpy (ie->name, name, sizeof ie->name);
+          hash_insert (&index->entries, &ie->elem.hash_elem);
+          if (ofs == index->end)
+            index->end += sizeof e;
+        }
+      else if (ofs < index->end)
+        list_push_front (&index->free_slots, &ie->elem.list_elem);
+      else
+        free (ie);
+    }
+
  done:
+  inode_unlock_dir (dir->inode);
   return success;
 }
 
+/* Returns true if directory INODE has no entries.  The caller
+   must hold INODE's directory lock. */
+static bool
+is_empty (struct inode *inode) 
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use)
+      return false;
+  return true;
+}
+
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs
+   if there is no file with the given NAME, or if NAME is a
+   directory that is not empty or is open elsewhere (for
+   example, as a process's working directory). */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -193,6 +391,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock_dir (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -202,16 +402,56 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* A directory must be empty and not in use.  Its directory
+     lock stays held until it is marked removed, so that nothing
+     can be added to it in between. */
+  if (inode_is_dir (inode))
+    {
+      inode_lock_dir (inode);
+      if (inode_open_cnt (inode) > 1 || !is_empty (inode))
+        {
+          inode_unlock_dir (inode);
+          goto done;
+        }
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
-    goto done;
+    {
+      if (inode_is_dir (inode))
+        inode_unlock_dir (inode);
+      goto done;
+    }
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+  /* Move it to the index's free slots.  The index cannot have
+     been discarded since lookup() used it. */
+  index = inode_get_dir_index (dir->inode);
+  if (index != NULL) 
+    {
+      struct index_entry key;
+      struct hash_elem *he;
+
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_delete (&index->entries, &key.elem.hash_elem);
+      ASSERT (he != NULL);
+      list_push_front (&index->free_slots,
+                       &hash_entry (he, struct index_entry,
+                                    elem.hash_elem)->elem.list_elem);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
+  if (inode_is_dir (inode))
+    {
+      dcache_purge_dir (inode_get_inumber (inode));
+      inode_unlock_dir (inode);
+    }
   success = true;
 
  done:
+  inode_unlock_dir (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -221,17 +461,126 @@ dir_remove (struct dir *dir, const char *name)
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  return dir_readdir_at (dir->inode, &dir->pos, name);
+}
+
+/* Reads the first directory entry at or after byte offset *POS
+   in directory INODE, stores its name in NAME, and advances *POS
+   past it.  Returns true if successful, false if the directory
+   contains no more entries.  Lets an open file on a directory
+   keep its own position. */
+bool
+dir_readdir_at (struct inode *inode, off_t *pos, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool success = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock_dir (inode);
+  while (inode_read_at (inode, &e, sizeof e, *pos) == sizeof e) 
     {
-      dir->pos += sizeof e;
+      *pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  inode_unlock_dir (inode);
+  return success;
+}
+
+/* Returns a hash value for index_entry E. */
+static unsigned
+index_entry_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_string (hash_entry (e, struct index_entry,
+                                  elem.hash_elem)->name);
+}
+
+/* Returns true if index_entry A's name precedes B's. */
+static bool
+index_entry_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED) 
+{
+  return strcmp (hash_entry (a, struct index_entry, elem.hash_elem)->name,
+                 hash_entry (b, struct index_entry, elem.hash_elem)->name) < 0;
+}
+
+/* Frees index_entry E. */
+static void
+index_entry_free (struct hash_elem *e, void *aux UNUSED) 
+{
+  free (hash_entry (e, struct index_entry, elem.hash_elem));
+}
+
+/* Returns DIR's index, building it if necessary, or a null
+   pointer if memory is short.  The caller must hold DIR's
+   directory lock. */
+static struct dir_index *
+get_index (const struct dir *dir) 
+{
+  struct dir_index *index = inode_get_dir_index (dir->inode);
+  struct dir_entry e;
+
+  if (index != NULL)
+    return index;
+
+  index = malloc (sizeof *index);
+  if (index == NULL)
+    return NULL;
+  if (!hash_init (&index->entries, index_entry_hash, index_entry_less, NULL))
+    {
+      free (index);
+      return NULL;
+    }
+  list_init (&index->free_slots);
+  inode_set_dir_index (dir->inode, index);
+
+  for (index->end = 0;
+       inode_read_at (dir->inode, &e, sizeof e, index->end) == sizeof e;
+       index->end += sizeof e)
+    {
+      struct index_entry *ie = malloc (sizeof *ie);
+      if (ie == NULL)
+        {
+          discard_index (dir);
+          return NULL;
+        }
+      ie->ofs = index->end;
+      if (e.in_use) 
+        {
+          ie->inode_sector = e.inode_sector;
+          strlcpy (ie->name, e.name, sizeof ie->name);
+          hash_insert (&index->entries, &ie->elem.hash_elem);
+        }
+      else
+        list_push_back (&index->free_slots, &ie->elem.list_elem);
+    }
+  return index;
+}
+
+/* Frees DIR's index, if any.  The caller must hold DIR's
+   directory lock. */
+static void
+discard_index (const struct dir *dir) 
+{
+  dir_index_destroy (inode_get_dir_index (dir->inode));
+  inode_set_dir_index (dir->inode, NULL);
+}
+
+/* Frees INDEX, if it is nonnull.  Called when the inode it
+   belongs to is closed for the last time. */
+void
+dir_index_destroy (struct dir_index *index) 
+{
+  if (index != NULL) 
+    {
+      hash_destroy (&index->entries, index_entry_free);
+      while (!list_empty (&index->free_slots))
+        free (list_entry (list_pop_front (&index->free_slots),
+                          struct index_entry, elem.list_elem));
+      free (index);
+    }
 }
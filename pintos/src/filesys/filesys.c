@@ -2,28 +2,39 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
-#include "devices/disk.h"
+#include "filesys/journal.h"
+#include "devices/block.h"
+#include "threads/thread.h"
 
-/* The disk that contains the file system. */
-struct disk *filesys_disk;
+/* The block device that contains the file system. */
+struct block *filesys_disk;
 
 static void do_format (void);
+static struct dir *resolve (const char *path, char name[NAME_MAX + 1]);
+static struct inode *open_path (const char *path);
+static bool create (const char *name, off_t initial_size, bool is_dir);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
 void
 filesys_init (bool format) 
 {
-  filesys_disk = disk_get (0, 1);
+  filesys_disk = block_get_role (BLOCK_FILESYS);
   if (filesys_disk == NULL)
-    PANIC ("hd0:1 (hdb) not present, file system initialization failed");
+    PANIC ("no file system device found, "
+           "file system initialization failed");
 
+  cache_init ();
+  dcache_init ();
   inode_init ();
   free_map_init ();
+  journal_init (format);
 
   if (format) 
     do_format ();
@@ -36,7 +47,9 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  journal_done ();
   free_map_close ();
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -46,20 +59,20 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
-  disk_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
-  if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
-  dir_close (dir);
+  return create (name, initial_size, false);
+}
 
-  return success;
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) 
+{
+  return create (name, 16, true);
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file or directory with the given NAME.
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -67,37 +80,209 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
-  struct inode *inode = NULL;
-
-  if (dir != NULL)
-    dir_lookup (dir, name, &inode);
-  dir_close (dir);
-
-  return file_open (inode);
+  return file_open (open_path (name));
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if NAME is a directory
+   that is not empty or is in use, or if an internal memory
+   allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char part[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  dir = resolve (name, part);
+  if (dir == NULL)
+    return false;
+  journal_begin ();
+  success = dir_remove (dir, part);
   dir_close (dir); 
+  journal_end ();
 
   return success;
 }
-
+
+/* Changes the current thread's working directory to NAME.
+   Returns true if successful, false on failure. */
+bool
+filesys_chdir (const char *name) 
+{
+  struct thread *t = thread_current ();
+  struct inode *inode = open_path (name);
+  struct dir *dir;
+
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
+/* Creates a file, or a directory if IS_DIR is true, named NAME.
+   A directory starts with room for INITIAL_SIZE entries;
+   otherwise INITIAL_SIZE is in bytes. */
+static bool
+create (const char *name, off_t initial_size, bool is_dir) 
+{
+  char part[NAME_MAX + 1];
+  disk_sector_t inode_sector = 0;
+  struct dir *dir;
+  bool success;
+
+  dir = resolve (name, part);
+  if (dir == NULL)
+    return false;
+  journal_begin ();
+  success = (free_map_allocate (1, &inode_sector)
+             && (is_dir
+                 ? dir_create (inode_sector, initial_size,
+                               inode_get_inumber (dir_get_inode (dir)))
+                 : inode_create (inode_sector, initial_size))
+             && dir_add (dir, part, inode_sector));
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+  journal_end ();
+
+  return success;
+}
+
+/* Returns the inode sector of the current thread's working
+   directory. */
+static disk_sector_t
+cwd_sector (void) 
+{
+  struct dir *cwd = thread_current ()->cwd;
+  return cwd != NULL ? inode_get_inumber (dir_get_inode (cwd)) : ROOT_DIR_SECTOR;
+}
+
+/* Extracts a file name part from *SRCP into PART, and updates
+   *SRCP so that the next call will return the next file name
+   part.  Returns 1 if successful, 0 at end of string, -1 for a
+   too-long file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp) 
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX character from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0') 
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++; 
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Resolves PATH, which is relative to the working directory
+   unless it starts with "/".  On success, stores PATH's last
+   component in NAME (or an empty string if PATH is "/") and
+   returns the directory that should contain it, opened, which
+   the caller must close.  Fails if PATH is empty, has a
+   component that is too long, or passes through something that
+   is not an existing directory.
+
+   Directories along the way are walked by sector without being
+   opened, since each step is normally answered by the dentry
+   cache.  The last one is opened through its entry in its
+   parent, so that it cannot be removed between being found and
+   being opened, and holding it open keeps it from being removed
+   while the caller uses it. */
+static struct dir *
+resolve (const char *path, char name[NAME_MAX + 1]) 
+{
+  disk_sector_t sector = *path == '/' ? ROOT_DIR_SECTOR : cwd_sector ();
+  char part[NAME_MAX + 1];
+  char last_dir[NAME_MAX + 1];
+  struct inode *inode;
+  int result;
+
+  if (*path == '\0')
+    return NULL;
+
+  /* SECTOR lags two components behind PART: LAST_DIR is the
+     component within SECTOR that names the directory to contain
+     NAME, or an empty string if that directory is SECTOR
+     itself. */
+  name[0] = last_dir[0] = '\0';
+  while ((result = get_next_part (part, &path)) > 0) 
+    {
+      if (last_dir[0] != '\0') 
+        {
+          bool is_dir;
+          if (!dir_lookup_sector (sector, last_dir, &sector, &is_dir)
+              || !is_dir)
+            return NULL;
+        }
+      strlcpy (last_dir, name, sizeof last_dir);
+      strlcpy (name, part, NAME_MAX + 1);
+    }
+  if (result < 0)
+    return NULL;
+
+  inode = (last_dir[0] != '\0'
+           ? dir_open_entry (sector, last_dir)
+           : inode_open (sector));
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return NULL;
+    }
+  return dir_open (inode);
+}
+
+/* Opens and returns the inode named by PATH, or a null pointer
+   if there is none. */
+static struct inode *
+open_path (const char *path) 
+{
+  char name[NAME_MAX + 1];
+  struct dir *dir;
+  struct inode *inode;
+
+  dir = resolve (path, name);
+  if (dir == NULL)
+    return NULL;
+  if (name[0] == '\0')
+    inode = inode_reopen (dir_get_inode (dir));
+  else
+    inode = dir_open_entry (inode_get_inumber (dir_get_inode (dir)), name);
+  dir_close (dir);
+  return inode;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
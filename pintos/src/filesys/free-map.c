@@ -1,51 +1,184 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <list.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Number of free map bits stored in one sector of its file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
+/* A maximal run of free sectors. */
+struct extent
+  {
+    struct list_elem elem;      /* Element in free_extents. */
+    disk_sector_t start;        /* First free sector. */
+    size_t cnt;                 /* Number of free sectors. */
+  };
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct bitmap *dirty_map;     /* Free map file sectors to write. */
+static struct bitmap *pending_map;   /* Released, not yet reusable. */
+static size_t pending_cnt;           /* Number of bits set in pending_map. */
+static struct lock free_map_lock;    /* Protects all of the above. */
+
+/* Index of the runs of free sectors in free_map, in order of
+   starting sector, with adjacent runs always merged.  free_map
+   remains the authority: if memory for the index runs out, it is
+   discarded and rebuilt from free_map on the next allocation.
+   Protected by free_map_lock. */
+static struct list free_extents;
+static bool extents_valid;
+
+static bool build_extents (void);
+static void discard_extents (void);
+static disk_sector_t choose_sectors (size_t cnt, bool near,
+                                     disk_sector_t goal);
+static void extents_remove (disk_sector_t, size_t cnt);
+static void extents_insert (disk_sector_t, size_t cnt);
+static void mark_dirty (disk_sector_t, size_t cnt);
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
-  free_map = bitmap_create (disk_size (filesys_disk));
+  free_map = bitmap_create (block_size (filesys_disk));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTOR_CNT, true);
+  dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                           DISK_SECTOR_SIZE));
+  pending_map = bitmap_create (bitmap_size (free_map));
+  if (dirty_map == NULL || pending_map == NULL)
+    PANIC ("bitmap creation failed--disk is too large");
+  pending_cnt = 0;
+  list_init (&free_extents);
+  extents_valid = false;
+  lock_init (&free_map_lock);
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
-   Returns true if successful, false if all sectors were
-   available. */
+/* Allocates CNT consecutive sectors and stores the first into
+   *SECTORP, choosing the smallest free run that is big enough.
+   Returns true if successful, false if no run of CNT free
+   sectors was available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Allocates CNT consecutive sectors and stores the first into
+   *SECTORP, starting at GOAL if possible, otherwise as close
+   after GOAL as possible, otherwise wherever fits best.  A GOAL
+   of 0 means no preference.  Returns true if successful, false
+   if no run of CNT free sectors was available.
+
+   The change reaches the free map file only when it is next
+   flushed. */
+bool
+free_map_allocate_near (size_t cnt, disk_sector_t goal,
+                        disk_sector_t *sectorp) 
+{
+  disk_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  if (extents_valid || build_extents ())
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      sector = choose_sectors (cnt, goal != 0, goal);
+      if (sector != BITMAP_ERROR)
+        extents_remove (sector, cnt);
     }
+  else
+    sector = bitmap_scan (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR)
+    {
+      ASSERT (bitmap_none (free_map, sector, cnt));
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      mark_dirty (sector, cnt);
+    }
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Releases CNT sectors starting at SECTOR.  They become
+   available for use at the next call to free_map_commit(), that
+   is, once the journal transaction that stopped referring to them
+   has committed.  Until then, a crash leaves them as they were,
+   so they must not be reused. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  ASSERT (bitmap_none (pending_map, sector, cnt));
+  bitmap_set_multiple (pending_map, sector, cnt, true);
+  pending_cnt += cnt;
+  lock_release (&free_map_lock);
+}
+
+/* Makes the sectors released since the last call available for
+   use.  Called by the journal after each commit. */
+void
+free_map_commit (void) 
+{
+  size_t size = bitmap_size (pending_map);
+  size_t start = 0;
+
+  lock_acquire (&free_map_lock);
+  while (pending_cnt > 0)
+    {
+      size_t end, cnt;
+
+      start = bitmap_scan (pending_map, start, 1, true);
+      ASSERT (start != BITMAP_ERROR);
+      end = bitmap_scan (pending_map, start, 1, false);
+      if (end == BITMAP_ERROR)
+        end = size;
+      cnt = end - start;
+
+      bitmap_set_multiple (pending_map, start, cnt, false);
+      pending_cnt -= cnt;
+      bitmap_set_multiple (free_map, start, cnt, false);
+      mark_dirty (start, cnt);
+      if (extents_valid)
+        extents_insert (start, cnt);
+      start = end;
+    }
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map file that have changed
+   since they were last written. */
+void
+free_map_flush (void) 
+{
+  size_t bit_cnt = bitmap_size (free_map);
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (i = 0; i < bitmap_size (dirty_map); i++)
+      if (bitmap_test (dirty_map, i)) 
+        {
+          size_t start = i * BITS_PER_SECTOR;
+          size_t cnt = bit_cnt - start;
+          if (cnt > BITS_PER_SECTOR)
+            cnt = BITS_PER_SECTOR;
+          if (bitmap_write_range (free_map, free_map_file, start, cnt))
+            bitmap_reset (dirty_map, i);
+        }
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,12 +190,15 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  bitmap_set_all (dirty_map, false);
+  discard_extents ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
 }
 
@@ -71,7 +207,8 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
-  /* Create inode. */
+  /* Create inode.  All of its sectors are allocated now, so that
+     writing the free map never has to allocate. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
     PANIC ("free map creation failed");
 
@@ -81,4 +218,197 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
+}
+
+/* Rebuilds free_extents from free_map.  Returns true if
+   successful, false if memory ran out.  The caller must hold
+   free_map_lock. */
+static bool
+build_extents (void) 
+{
+  size_t size = bitmap_size (free_map);
+  size_t start = 0;
+
+  discard_extents ();
+  while (start < size)
+    {
+      struct extent *x;
+      size_t end;
+
+      start = bitmap_scan (free_map, start, 1, false);
+      if (start == BITMAP_ERROR)
+        break;
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = size;
+
+      x = malloc (sizeof *x);
+      if (x == NULL)
+        {
+          discard_extents ();
+          return false;
+        }
+      x->start = start;
+      x->cnt = end - start;
+      list_push_back (&free_extents, &x->elem);
+      start = end;
+    }
+  extents_valid = true;
+  return true;
+}
+
+/* Frees free_extents and marks it invalid.  The caller must hold
+   free_map_lock. */
+static void
+discard_extents (void) 
+{
+  while (!list_empty (&free_extents))
+    free (list_entry (list_pop_front (&free_extents), struct extent, elem));
+  extents_valid = false;
+}
+
+/* Returns the first of CNT consecutive free sectors to allocate,
+   or BITMAP_ERROR if there is no run that long.  If NEAR is true,
+   prefers GOAL itself, then the first run after GOAL that is
+   long enough.  Otherwise, or if there is no such run, picks the
+   shortest run that is long enough.  The caller must hold
+   free_map_lock. */
+static disk_sector_t
+choose_sectors (size_t cnt, bool near, disk_sector_t goal) 
+{
+  struct extent *after = NULL;
+  struct extent *best = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&free_extents); e != list_end (&free_extents);
+       e = list_next (e))
+    {
+      struct extent *x = list_entry (e, struct extent, elem);
+      if (x->cnt < cnt)
+        continue;
+      if (near && x->start <= goal && goal - x->start <= x->cnt - cnt)
+        return goal;
+      if (near && after == NULL && x->start > goal)
+        after = x;
+      if (best == NULL || x->cnt < best->cnt)
+        best = x;
+    }
+  if (after != NULL)
+    return after->start;
+  return best != NULL ? best->start : BITMAP_ERROR;
+}
+
+/* Removes the CNT sectors starting at SECTOR, which must all lie
+   in one free run, from free_extents.  The caller must hold
+   free_map_lock. */
+static void
+extents_remove (disk_sector_t sector, size_t cnt) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&free_extents); e != list_end (&free_extents);
+       e = list_next (e))
+    {
+      struct extent *x = list_entry (e, struct extent, elem);
+      disk_sector_t end = x->start + x->cnt;
+
+      if (sector < x->start || sector >= end)
+        continue;
+      ASSERT (sector + cnt <= end);
+
+      if (sector == x->start)
+        {
+          /* Take from the front. */
+          x->start += cnt;
+          x->cnt -= cnt;
+          if (x->cnt == 0)
+            {
+              list_remove (&x->elem);
+              free (x);
+            }
+        }
+      else if (sector + cnt == end)
+        {
+          /* Take from the back. */
+          x->cnt -= cnt;
+        }
+      else
+        {
+          /* Split in two. */
+          struct extent *tail = malloc (sizeof *tail);
+          if (tail == NULL)
+            {
+              discard_extents ();
+              return;
+            }
+          tail->start = sector + cnt;
+          tail->cnt = end - tail->start;
+          x->cnt = sector - x->start;
+          list_insert (list_next (&x->elem), &tail->elem);
+        }
+      return;
+    }
+  NOT_REACHED ();
+}
+
+/* Adds the CNT sectors starting at SECTOR, which were in use, to
+   free_extents, merging with the runs on either side.  The
+   caller must hold free_map_lock. */
+static void
+extents_insert (disk_sector_t sector, size_t cnt) 
+{
+  struct extent *prev = NULL, *next = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&free_extents); e != list_end (&free_extents);
+       e = list_next (e))
+    {
+      next = list_entry (e, struct extent, elem);
+      if (next->start > sector)
+        break;
+      prev = next;
+      next = NULL;
+    }
+
+  if (prev != NULL && prev->start + prev->cnt == sector)
+    {
+      prev->cnt += cnt;
+      if (next != NULL && sector + cnt == next->start)
+        {
+          prev->cnt += next->cnt;
+          list_remove (&next->elem);
+          free (next);
+        }
+    }
+  else if (next != NULL && sector + cnt == next->start)
+    {
+      next->start = sector;
+      next->cnt += cnt;
+    }
+  else
+    {
+      struct extent *x = malloc (sizeof *x);
+      if (x == NULL)
+        {
+          discard_extents ();
+          return;
+        }
+      x->start = sector;
+      x->cnt = cnt;
+      list_insert (e, &x->elem);
+    }
+}
+
+/* Records that the free map file sectors holding the bits for
+   the CNT sectors starting at SECTOR need to be written.  The
+   caller must hold free_map_lock. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt) 
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  if (cnt > 0)
+    bitmap_set_multiple (dirty_map, first, last - first + 1, true);
 }
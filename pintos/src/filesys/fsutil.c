@@ -1,16 +1,22 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <inttypes.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
-#include "devices/disk.h"
+#include "devices/block.h"
+#include "devices/timer.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
+/* Maximum number of sectors copied by fsutil_copybench(). */
+#define COPYBENCH_SECTORS 4096
+
 /* List files in the root directory. */
 void
 fsutil_ls (char **argv UNUSED) 
@@ -66,17 +72,35 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
-/* Copies from the "scratch" disk, hdc or hd1:0 to file ARGV[1]
+/* Queues a read of the sectors holding the first PGSIZE bytes,
+   at most, of the SIZE bytes starting at *SECTOR on block device
+   B into BUFFER, using request R, and advances *SECTOR past
+   them. */
+static void
+queue_read (struct block *b, struct block_request *r, void *buffer,
+            disk_sector_t *sector, off_t size) 
+{
+  r->sec_no = *sector;
+  r->cnt = DIV_ROUND_UP (size > PGSIZE ? PGSIZE : size, DISK_SECTOR_SIZE);
+  r->buffer = buffer;
+  r->write = false;
+  r->func = NULL;
+  block_submit (b, r);
+  *sector += r->cnt;
+}
+
+/* Copies from the scratch device, normally hdc or hd1:0, to file
+   ARGV[1]
    in the file system.
 
-   The current sector on the scratch disk must begin with the
+   The current sector on the scratch device must begin with the
    string "PUT\0" followed by a 32-bit little-endian integer
    indicating the file size in bytes.  Subsequent sectors hold
    the file content.
 
    The first call to this function will read starting at the
-   beginning of the scratch disk.  Later calls advance across the
-   disk.  This disk position is independent of that used for
+   beginning of the scratch device.  Later calls advance across
+   the device.  This position is independent of that used for
    fsutil_get(), so all `put's should precede all `get's. */
 void
 fsutil_put (char **argv) 
@@ -84,30 +108,33 @@ fsutil_put (char **argv)
   static disk_sector_t sector = 0;
 
   const char *file_name = argv[1];
-  struct disk *src;
+  struct block *src;
   struct file *dst;
+  struct block_request req[2];
   off_t size;
-  void *buffer;
+  void *buffer[2];
+  int cur;
 
   printf ("Putting '%s' into the file system...\n", file_name);
 
-  /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
-  if (buffer == NULL)
-    PANIC ("couldn't allocate buffer");
+  /* Allocate buffers. */
+  buffer[0] = palloc_get_page (PAL_ASSERT);
+  buffer[1] = palloc_get_page (PAL_ASSERT);
 
-  /* Open source disk and read file size. */
-  src = disk_get (1, 0);
+  /* Open source device and read file size. */
+  src = block_get_role (BLOCK_SCRATCH);
   if (src == NULL)
-    PANIC ("couldn't open source disk (hdc or hd1:0)");
+    PANIC ("couldn't open scratch device (hdc or hd1:0)");
 
   /* Read file size. */
-  disk_read (src, sector++, buffer);
-  if (memcmp (buffer, "PUT", 4))
-    PANIC ("%s: missing PUT signature on scratch disk", file_name);
-  size = ((int32_t *) buffer)[1];
+  block_read (src, sector++, buffer[0]);
+  if (memcmp (buffer[0], "PUT", 4))
+    PANIC ("%s: missing PUT signature on scratch device", file_name);
+  size = ((int32_t *) buffer[0])[1];
   if (size < 0)
     PANIC ("%s: invalid file size %d", file_name, size);
+  if (sector + DIV_ROUND_UP (size, DISK_SECTOR_SIZE) > block_size (src))
+    PANIC ("%s: file size %d exceeds scratch device", file_name, size);
   
   /* Create destination file. */
   if (!filesys_create (file_name, size))
@@ -116,32 +143,44 @@ fsutil_put (char **argv)
   if (dst == NULL)
     PANIC ("%s: open failed", file_name);
 
-  /* Do copy. */
+  /* Do copy.  The scratch device reads the next chunk while the
+     current one is written into the file system, which is on
+     another device. */
+  cur = 0;
+  if (size > 0)
+    queue_read (src, &req[cur], buffer[cur], &sector, size);
   while (size > 0)
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      disk_read (src, sector++, buffer);
-      if (file_write (dst, buffer, chunk_size) != chunk_size)
+      int chunk_size = size > PGSIZE ? PGSIZE : size;
+
+      block_wait (&req[cur]);
+      if (size > chunk_size)
+        queue_read (src, &req[!cur], buffer[!cur], &sector,
+                    size - chunk_size);
+      if (file_write (dst, buffer[cur], chunk_size) != chunk_size)
         PANIC ("%s: write failed with %"PROTd" bytes unwritten",
                file_name, size);
       size -= chunk_size;
+      cur = !cur;
     }
 
   /* Finish up. */
   file_close (dst);
-  free (buffer);
+  palloc_free_page (buffer[0]);
+  palloc_free_page (buffer[1]);
 }
 
-/* Copies file FILE_NAME from the file system to the scratch disk.
+/* Copies file FILE_NAME from the file system to the scratch
+   device.
 
-   The current sector on the scratch disk will receive "GET\0"
+   The current sector on the scratch device will receive "GET\0"
    followed by the file's size in bytes as a 32-bit,
    little-endian integer.  Subsequent sectors receive the file's
    data.
 
    The first call to this function will write starting at the
-   beginning of the scratch disk.  Later calls advance across the
-   disk.  This disk position is independent of that used for
+   beginning of the scratch device.  Later calls advance across
+   the device.  This position is independent of that used for
    fsutil_put(), so all `put's should precede all `get's. */
 void
 fsutil_get (char **argv)
@@ -149,17 +188,19 @@ fsutil_get (char **argv)
   static disk_sector_t sector = 0;
 
   const char *file_name = argv[1];
-  void *buffer;
+  char *buffer[2];
+  struct block_request req[2];
   struct file *src;
-  struct disk *dst;
+  struct block *dst;
   off_t size;
+  bool pending;
+  int cur;
 
   printf ("Getting '%s' from the file system...\n", file_name);
 
-  /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
-  if (buffer == NULL)
-    PANIC ("couldn't allocate buffer");
+  /* Allocate buffers. */
+  buffer[0] = palloc_get_page (PAL_ASSERT);
+  buffer[1] = palloc_get_page (PAL_ASSERT);
 
   /* Open source file. */
   src = filesys_open (file_name);
@@ -167,31 +208,107 @@ fsutil_get (char **argv)
     PANIC ("%s: open failed", file_name);
   size = file_length (src);
 
-  /* Open target disk. */
-  dst = disk_get (1, 0);
+  /* Open target device. */
+  dst = block_get_role (BLOCK_SCRATCH);
   if (dst == NULL)
-    PANIC ("couldn't open target disk (hdc or hd1:0)");
+    PANIC ("couldn't open scratch device (hdc or hd1:0)");
   
   /* Write size to sector 0. */
-  memset (buffer, 0, DISK_SECTOR_SIZE);
-  memcpy (buffer, "GET", 4);
-  ((int32_t *) buffer)[1] = size;
-  disk_write (dst, sector++, buffer);
+  memset (buffer[0], 0, DISK_SECTOR_SIZE);
+  memcpy (buffer[0], "GET", 4);
+  ((int32_t *) buffer[0])[1] = size;
+  block_write (dst, sector++, buffer[0]);
   
-  /* Do copy. */
+  /* Do copy.  Each chunk is written to the scratch device while
+     the next one is read from the file system, which is on another
+     device. */
+  cur = 0;
+  pending = false;
   while (size > 0) 
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      if (sector >= disk_size (dst))
-        PANIC ("%s: out of space on scratch disk", file_name);
-      if (file_read (src, buffer, chunk_size) != chunk_size)
+      int chunk_size = size > PGSIZE ? PGSIZE : size;
+      size_t sector_cnt = DIV_ROUND_UP (chunk_size, DISK_SECTOR_SIZE);
+      struct block_request *r = &req[cur];
+
+      if (sector + sector_cnt > block_size (dst))
+        PANIC ("%s: out of space on scratch device", file_name);
+      if (file_read (src, buffer[cur], chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, DISK_SECTOR_SIZE - chunk_size);
-      disk_write (dst, sector++, buffer);
+      memset (buffer[cur] + chunk_size, 0,
+              sector_cnt * DISK_SECTOR_SIZE - chunk_size);
+
+      /* The other buffer's write must be done before it is
+         reused. */
+      if (pending)
+        block_wait (&req[!cur]);
+      r->sec_no = sector;
+      r->cnt = sector_cnt;
+      r->buffer = buffer[cur];
+      r->write = true;
+      r->func = NULL;
+      block_submit (dst, r);
+      pending = true;
+
+      sector += sector_cnt;
       size -= chunk_size;
+      cur = !cur;
     }
+  if (pending)
+    block_wait (&req[!cur]);
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_page (buffer[0]);
+  palloc_free_page (buffer[1]);
 }
+
+/* Measures the throughput of copying up to COPYBENCH_SECTORS
+   sectors from the file system device, normally hd0:1, to the
+   scratch device, normally hd1:0, which are on different
+   channels.  The copy is done twice: first one sector at a time,
+   alternating between the devices, and then with block_copy(),
+   which keeps both busy.  The file system device is only read,
+   but the scratch device's contents are destroyed, so this must
+   follow any `put' or `get'. */
+void
+fsutil_copybench (char **argv UNUSED) 
+{
+  struct block *src = block_get_role (BLOCK_FILESYS);
+  struct block *dst = block_get_role (BLOCK_SCRATCH);
+  disk_sector_t cnt, sector;
+  int64_t start, serial_ticks, pipelined_ticks;
+  void *buffer;
+
+  if (src == NULL || dst == NULL)
+    PANIC ("copybench needs file system and scratch devices");
+  cnt = COPYBENCH_SECTORS;
+  if (cnt > block_size (src))
+    cnt = block_size (src);
+  if (cnt > block_size (dst))
+    cnt = block_size (dst);
+
+  printf ("Copying %"PRDSNu" sectors from %s to %s...\n",
+          cnt, block_name (src), block_name (dst));
+
+  buffer = palloc_get_page (PAL_ASSERT);
+  start = timer_ticks ();
+  for (sector = 0; sector < cnt; sector++) 
+    {
+      block_read (src, sector, buffer);
+      block_write (dst, sector, buffer);
+    }
+  serial_ticks = timer_elapsed (start);
+  palloc_free_page (buffer);
+
+  start = timer_ticks ();
+  block_copy (dst, 0, src, 0, cnt);
+  pipelined_ticks = timer_elapsed (start);
+
+  printf ("Serialized: %"PRId64" ticks, %"PRId64" kB/s\n", serial_ticks,
+          (int64_t) cnt * DISK_SECTOR_SIZE / 1024 * TIMER_FREQ
+          / (serial_ticks > 0 ? serial_ticks : 1));
+  printf ("Pipelined: %"PRId64" ticks, %"PRId64" kB/s\n", pipelined_ticks,
+          (int64_t) cnt * DISK_SECTOR_SIZE / 1024 * TIMER_FREQ
+          / (pipelined_ticks > 0 ? pipelined_ticks : 1));
+}
+
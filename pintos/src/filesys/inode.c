@@ -1,23 +1,55 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector pointers in the on-disk inode itself, and in
+   one indirect block. */
+#define DIRECT_CNT 122
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* Number of data sectors an inode can address. */
+#define MAX_SECTORS (DIRECT_CNT + INDIRECT_CNT + INDIRECT_CNT * INDIRECT_CNT)
+
+/* Maximum number of sectors of one read that are prefetched
+   ahead of copying, so a large read does not evict its own
+   beginning from the buffer cache. */
+#define PREFETCH_MAX 32
+
 /* On-disk inode.
-   Must be exactly DISK_SECTOR_SIZE bytes long. */
+   Must be exactly DISK_SECTOR_SIZE bytes long.
+
+   The first DIRECT_CNT data sectors are listed in DIRECT, the
+   next INDIRECT_CNT in the indirect block, and the rest in the
+   indirect blocks listed by the doubly indirect block.  A
+   pointer of 0 (the free map inode, never a data or index
+   sector) is a hole: it reads as zeros and is allocated on first
+   write.
+
+   The on-disk inode is not copied into `struct inode'; its
+   fields are read and written in place in the buffer cache. */
 struct inode_disk
   {
-    disk_sector_t start;                /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t is_dir;                    /* Nonzero for a directory. */
+    disk_sector_t parent;               /* Parent, for a directory. */
+    disk_sector_t direct[DIRECT_CNT];   /* Direct data sectors. */
+    disk_sector_t indirect;             /* Indirect block. */
+    disk_sector_t doubly_indirect;      /* Doubly indirect block. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,51 +60,206 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* Byte offset of MEMBER within the on-disk inode. */
+#define DISK_OFS(MEMBER) offsetof (struct inode_disk, MEMBER)
+
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     disk_sector_t sector;               /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
-    struct inode_disk data;             /* Inode content. */
+    struct lock lock;                   /* Serializes extension. */
+    struct lock dir_lock;               /* Serializes directory operations. */
+    disk_sector_t alloc_hint;           /* Next sector to allocate, under
+                                           `lock'. */
+    struct dir_index *dir_index;        /* Owned by directory.c. */
   };
 
+/* A sector's worth of zeros, for initializing new sectors. */
+static char zeros[DISK_SECTOR_SIZE];
+
+/* State for filling holes while looking up sectors. */
+struct grow
+  {
+    disk_sector_t hint;                 /* Where to allocate next. */
+    bool meta;                          /* Journal new data sectors? */
+  };
+
+/* Writes SIZE bytes from BUFFER into metadata sector SECTOR
+   starting at byte offset OFS, as part of the running journal
+   transaction. */
+static void
+write_meta (disk_sector_t sector, const void *buffer, int ofs, int size) 
+{
+  journal_log (sector, ofs != 0 || size != DISK_SECTOR_SIZE);
+  cache_write_at (sector, buffer, ofs, size);
+}
+
+/* Allocates a sector, preferably at G->hint, fills it with
+   zeros, and stores its number in *SECTORP.  The zeros are
+   journaled if META is true; otherwise they reach disk before
+   the pointer to the sector commits.  Advances G->hint past the new
+   sector, so that consecutive allocations are laid out
+   contiguously.  Returns true if successful, false if the disk
+   is full. */
+static bool
+allocate_zeroed (disk_sector_t *sectorp, bool meta, struct grow *g) 
+{
+  if (!free_map_allocate_near (1, g->hint, sectorp))
+    return false;
+  if (meta)
+    write_meta (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+  else 
+    {
+      cache_write (*sectorp, zeros);
+      journal_order (*sectorp);
+    }
+  g->hint = *sectorp + 1;
+  return true;
+}
+
+/* Returns the sector pointer stored at byte offset OFS within
+   SECTOR, which is an on-disk inode or an indirect block.  If it
+   is a hole and G is nonnull, first fills it with a new zeroed
+   sector, which is an index block if IS_INDEX is true and a data
+   sector otherwise.  Returns 0 for a hole that was not or could
+   not be filled. */
+static disk_sector_t
+get_slot (disk_sector_t sector, off_t ofs, bool is_index, struct grow *g) 
+{
+  disk_sector_t slot;
+
+  cache_read_at (sector, &slot, ofs, sizeof slot);
+  if (slot == 0 && g != NULL
+      && allocate_zeroed (&slot, is_index || g->meta, g))
+    write_meta (sector, &slot, ofs, sizeof slot);
+  return slot;
+}
+
+/* Returns the disk sector that holds data sector IDX of the file
+   whose on-disk inode is in INODE_SECTOR, or 0 if it is a hole.
+   If G is nonnull, holes along the way are filled, and 0 is
+   returned only if the disk is full.  Reads at most three
+   sectors, which are normally in the buffer cache. */
+static disk_sector_t
+index_to_sector (disk_sector_t inode_sector, size_t idx, struct grow *g) 
+{
+  const size_t ptr_size = sizeof (disk_sector_t);
+  disk_sector_t sector;
+
+  ASSERT (idx < MAX_SECTORS);
+
+  if (idx < DIRECT_CNT)
+    return get_slot (inode_sector, DISK_OFS (direct) + idx * ptr_size,
+                     false, g);
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT) 
+    {
+      sector = get_slot (inode_sector, DISK_OFS (indirect), true, g);
+      return sector != 0 ? get_slot (sector, idx * ptr_size, false, g) : 0;
+    }
+  idx -= INDIRECT_CNT;
+
+  sector = get_slot (inode_sector, DISK_OFS (doubly_indirect), true, g);
+  if (sector != 0)
+    sector = get_slot (sector, idx / INDIRECT_CNT * ptr_size, true, g);
+  return (sector != 0
+          ? get_slot (sector, idx % INDIRECT_CNT * ptr_size, false, g)
+          : 0);
+}
+
 /* Returns the disk sector that contains byte offset POS within
-   INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   INODE, or 0 if that byte lies in a hole.  G is as for
+   index_to_sector(). */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, struct grow *g) 
 {
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / DISK_SECTOR_SIZE;
-  else
-    return -1;
+  return index_to_sector (inode->sector, pos / DISK_SECTOR_SIZE, g);
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Returns true if INODE's data is file system metadata, that is,
+   if INODE is a directory or the free map. */
+static bool
+is_meta (const struct inode *inode) 
+{
+  return inode->sector == FREE_MAP_SECTOR || inode_is_dir (inode);
+}
+
+/* Frees SECTOR, an index block LEVEL levels above the data (0
+   for a data sector itself), along with every sector below it. */
+static void
+release_tree (disk_sector_t sector, int level) 
+{
+  size_t i;
+
+  if (sector == 0)
+    return;
+  if (level > 0)
+    for (i = 0; i < INDIRECT_CNT; i++) 
+      {
+        disk_sector_t slot;
+
+        cache_read_at (sector, &slot, i * sizeof slot, sizeof slot);
+        release_tree (slot, level - 1);
+      }
+  free_map_release (sector, 1);
+}
+
+/* Frees all of the data and index sectors of the inode in
+   INODE_SECTOR, but not INODE_SECTOR itself. */
+static void
+deallocate (disk_sector_t inode_sector) 
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    release_tree (get_slot (inode_sector, DISK_OFS (direct[i]), false, NULL), 0);
+  release_tree (get_slot (inode_sector, DISK_OFS (indirect), true, NULL), 1);
+  release_tree (get_slot (inode_sector, DISK_OFS (doubly_indirect), true,
+                          NULL), 2);
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+
+/* Protects open_inodes and the open_cnt of every open inode.
+   Held only for the table lookup, never across disk I/O. */
+static struct lock open_inodes_lock;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
 }
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   disk.
+/* Initializes an inode with LENGTH bytes of data and writes the
+   new inode to sector SECTOR on the file system disk.  IS_DIR and
+   PARENT give the inode's type and, for a directory, its parent
+   directory's inode sector.
+
+   The data starts out as one big hole, so creating a file takes
+   the same time whatever its length; sectors are allocated as
+   they are first written.  Only the free map is allocated in
+   full, so that writing it never has to allocate.
+
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
-bool
-inode_create (disk_sector_t sector, off_t length)
+static bool
+create (disk_sector_t sector, off_t length, bool is_dir, disk_sector_t parent)
 {
   struct inode_disk *disk_inode = NULL;
+  size_t sectors = bytes_to_sectors (length);
   bool success = false;
 
   ASSERT (length >= 0);
@@ -81,63 +268,97 @@ inode_create (disk_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+  if (sectors > MAX_SECTORS)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
-        {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
-            }
-          success = true; 
-        } 
+      disk_inode->is_dir = is_dir;
+      disk_inode->parent = parent;
+      write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
       free (disk_inode);
+      success = true;
+
+      if (sector == FREE_MAP_SECTOR) 
+        {
+          struct grow g;
+          size_t i;
+
+          g.hint = sector + 1;
+          g.meta = true;
+          for (i = 0; success && i < sectors; i++)
+            success = index_to_sector (sector, i, &g) != 0;
+          if (!success)
+            deallocate (sector);
+        }
     }
   return success;
 }
 
-/* Reads an inode from SECTOR
-   and returns a `struct inode' that contains it.
+/* Initializes a file inode with LENGTH bytes of data and
+   writes the new inode to sector SECTOR on the file system
+   disk.
+   Returns true if successful.
+   Returns false if memory or disk allocation fails. */
+bool
+inode_create (disk_sector_t sector, off_t length)
+{
+  return create (sector, length, false, 0);
+}
+
+/* Like inode_create(), but creates a directory inode whose
+   parent directory's inode is in sector PARENT. */
+bool
+inode_create_dir (disk_sector_t sector, off_t length, disk_sector_t parent)
+{
+  return create (sector, length, true, parent);
+}
+
+/* Returns a `struct inode' for the inode in SECTOR, sharing it
+   with any other opener.  The on-disk inode is not read here,
+   only when its fields are needed.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  lock_acquire (&open_inodes_lock);
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL) 
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  inode->alloc_hint = sector + 1;
+  inode->dir_index = NULL;
+  lock_init (&inode->lock);
+  lock_init (&inode->dir_lock);
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +367,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -168,21 +393,27 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      /* Remove from inode table and release lock. */
+      hash_delete (&open_inodes, &inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
+          deallocate (inode->sector);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          journal_end ();
         }
 
+      dir_index_destroy (inode->dir_index);
       free (inode); 
     }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -194,125 +425,321 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode) 
+{
+  return inode->removed;
+}
+
+/* Returns the number of openers of INODE. */
+int
+inode_open_cnt (const struct inode *inode) 
+{
+  int open_cnt;
+
+  lock_acquire (&open_inodes_lock);
+  open_cnt = inode->open_cnt;
+  lock_release (&open_inodes_lock);
+  return open_cnt;
+}
+
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode) 
+{
+  uint32_t is_dir;
+
+  cache_read_at (inode->sector, &is_dir, DISK_OFS (is_dir), sizeof is_dir);
+  return is_dir != 0;
+}
+
+/* Returns the inode sector of the directory that contains
+   directory INODE.  The root directory is its own parent. */
+disk_sector_t
+inode_get_parent (const struct inode *inode) 
+{
+  disk_sector_t parent;
+
+  ASSERT (inode_is_dir (inode));
+  cache_read_at (inode->sector, &parent, DISK_OFS (parent), sizeof parent);
+  return parent;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size > 0 ? size : 0;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
+
+/* Returns the total size of the IOV_CNT segments in IOV, or
+   INT32_MAX if that is larger. */
+static off_t
+iov_size (const struct iovec *iov, int iov_cnt) 
+{
+  size_t total = 0;
+  int i;
+
+  for (i = 0; i < iov_cnt; i++)
+    {
+      if (iov[i].iov_len > (size_t) INT32_MAX - total)
+        return INT32_MAX;
+      total += iov[i].iov_len;
+    }
+  return total;
+}
+
+/* Brings the sectors holding the SIZE bytes at OFFSET in INODE
+   into the buffer cache, reading each run of sectors that are
+   consecutive on disk with a single disk command. */
+static void
+prefetch (struct inode *inode, off_t offset, off_t size) 
+{
+  size_t idx = offset / DISK_SECTOR_SIZE;
+  size_t end = DIV_ROUND_UP (offset + size, DISK_SECTOR_SIZE);
+  disk_sector_t run_start = 0;
+  size_t run_cnt = 0;
+
+  if (end - idx > PREFETCH_MAX)
+    end = idx + PREFETCH_MAX;
+  for (; idx <= end; idx++) 
+    {
+      disk_sector_t sector = 0;
+
+      if (idx < end)
+        sector = index_to_sector (inode->sector, idx, NULL);
+      if (run_cnt > 0 && sector == run_start + run_cnt)
+        run_cnt++;
+      else 
+        {
+          if (run_cnt > 1)
+            cache_prefetch (run_start, run_cnt);
+          run_start = sector;
+          run_cnt = sector != 0;
+        }
+    }
+}
+
+/* Reads from INODE into the IOV_CNT segments in IOV, in order,
+   starting at position OFFSET.  Returns the number of bytes
+   actually read, which may be less than the total size of the
+   segments if an error occurs or end of file is reached.
+
+   The segments are filled in one pass over the file, so a
+   sector that spans two segments is looked up only once.
+
+   Reads take no lock of their own and run in parallel with each
+   other and with writes.  The file's length is sampled once, at
+   the start, and a writer publishes a new length only after the
+   data below it is in the cache, so a read never returns bytes
+   past the old end of file that have not been written yet. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iov_cnt,
+                off_t offset) 
 {
-  uint8_t *buffer = buffer_;
+  off_t size = iov_size (iov, iov_cnt);
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  off_t length, next;
+  size_t seg_ofs = 0;
+  disk_sector_t sector_idx = 0;
+  off_t sector_pos = -1;
+
+  if (offset < 0)
+    return 0;
+  length = inode_length (inode);
+
+  /* Fetch a read that spans several sectors with as few disk
+     commands as possible. */
+  if (offset < length && size > DISK_SECTOR_SIZE)
+    prefetch (inode, offset, size < length - offset ? size : length - offset);
 
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % DISK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = DISK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-      /* Number of bytes to actually copy out of this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
-
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      /* Number of bytes to actually copy out of this sector into
+         this segment. */
+      size_t seg_left = iov->iov_len - seg_ofs;
+      uint8_t *buffer = (uint8_t *) iov->iov_base + seg_ofs;
+      int chunk_size;
+      if (seg_left == 0) 
         {
-          /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+          iov++;
+          seg_ofs = 0;
+          continue;
         }
-      else 
+      if (min_left <= 0)
+        break;
+      chunk_size = seg_left < (size_t) min_left ? (int) seg_left : min_left;
+
+      /* Holes read as zeros. */
+      if (offset - sector_ofs != sector_pos) 
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          sector_pos = offset - sector_ofs;
+          sector_idx = byte_to_sector (inode, offset, NULL);
         }
+      if (sector_idx != 0)
+        cache_read_at (sector_idx, buffer, sector_ofs, chunk_size);
+      else
+        memset (buffer, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
+      seg_ofs += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+
+  /* Start fetching the sector after the last one read, on the
+     guess that the caller is reading sequentially. */
+  next = ROUND_UP (offset, DISK_SECTOR_SIZE);
+  if (bytes_read > 0 && next < length)
+    {
+      disk_sector_t next_idx = byte_to_sector (inode, next, NULL);
+      if (next_idx != 0)
+        cache_read_ahead (next_idx);
+    }
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up, the maximum file size is
+   reached, or an error occurs. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
-  off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size > 0 ? size : 0;
+  return inode_writev_at (inode, &iov, 1, offset);
+}
 
-  if (inode->deny_write_cnt)
+/* Writes the IOV_CNT segments in IOV, in order, into INODE,
+   starting at OFFSET.  Returns the number of bytes actually
+   written, which may be less than the total size of the
+   segments if the disk fills up, the maximum file size is
+   reached, or an error occurs.  Writing past end of file extends
+   the file; any gap before OFFSET is left as a hole.
+
+   As in inode_readv_at(), a sector that spans two segments is
+   looked up only once.
+
+   A write within the current length runs in parallel with reads
+   and with other such writes, taking INODE's lock only briefly
+   to fill a hole.  A write that extends the file holds the lock
+   throughout, so that extensions are serialized, and publishes
+   the new length only once all of its data has been written. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iov_cnt,
+                 off_t offset) 
+{
+  off_t size = iov_size (iov, iov_cnt);
+  off_t bytes_written = 0;
+  bool extending, meta;
+  size_t seg_ofs = 0;
+  disk_sector_t sector_idx = 0;
+  off_t sector_pos = -1;
+
+  /* Sampled without the lock: a write that races with
+     inode_deny_write() is ordered before it. */
+  if (inode->deny_write_cnt || offset < 0)
     return 0;
 
+  meta = is_meta (inode);
+  extending = size > inode_length (inode) - offset;
+  if (extending)
+    lock_acquire (&inode->lock);
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Number of bytes to actually write into this sector from
+         this segment. */
       int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      size_t seg_left = iov->iov_len - seg_ofs;
+      int chunk_size = (seg_left < (size_t) sector_left
+                        ? (int) seg_left : sector_left);
+      const uint8_t *buffer = (const uint8_t *) iov->iov_base + seg_ofs;
+      if (seg_left == 0) 
+        {
+          iov++;
+          seg_ofs = 0;
+          continue;
+        }
 
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if ((size_t) offset / DISK_SECTOR_SIZE >= MAX_SECTORS)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      /* Holes are filled under the lock, which get_slot()
+         rechecks, so two writers never fill the same one.  Each
+         fill is its own journal operation, begun after taking
+         the lock as for an extending write, so that a writer
+         waiting for the lock never holds up a commit. */
+      if (offset - sector_ofs != sector_pos) 
         {
-          /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+          sector_pos = offset - sector_ofs;
+          sector_idx = byte_to_sector (inode, offset, NULL);
         }
-      else 
+      if (sector_idx == 0) 
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
-          else
-            memset (bounce, 0, DISK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
+          struct grow g;
+
+          if (!extending)
+            lock_acquire (&inode->lock);
+          journal_begin ();
+          g.hint = inode->alloc_hint;
+          g.meta = meta;
+          sector_idx = byte_to_sector (inode, offset, &g);
+          inode->alloc_hint = g.hint;
+          journal_end ();
+          if (!extending)
+            lock_release (&inode->lock);
+          if (sector_idx == 0)
+            break;
         }
 
+      if (meta)
+        write_meta (sector_idx, buffer, sector_ofs, chunk_size);
+      else
+        cache_write_at (sector_idx, buffer, sector_ofs, chunk_size);
+
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
+      seg_ofs += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Publish the new length, now that the data is in place. */
+  if (extending) 
+    {
+      if (bytes_written > 0 && offset > inode_length (inode)) 
+        {
+          journal_begin ();
+          write_meta (inode->sector, &offset, DISK_OFS (length),
+                      sizeof offset);
+          journal_end ();
+        }
+      lock_release (&inode->lock);
+    }
 
   return bytes_written;
 }
@@ -322,8 +749,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,14 +761,69 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
+}
+
+/* Acquires INODE's directory lock, which serializes lookups and
+   updates of the directory stored in INODE. */
+void
+inode_lock_dir (struct inode *inode) 
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Releases INODE's directory lock. */
+void
+inode_unlock_dir (struct inode *inode) 
+{
+  lock_release (&inode->dir_lock);
+}
+
+/* Returns the directory index that directory.c attached to
+   INODE, or a null pointer if there is none.  The caller must
+   hold INODE's directory lock. */
+struct dir_index *
+inode_get_dir_index (const struct inode *inode) 
+{
+  return inode->dir_index;
+}
+
+/* Attaches directory index INDEX to INODE, replacing any
+   previous one.  It is freed by dir_index_destroy() when INODE
+   is closed for the last time.  The caller must hold INODE's
+   directory lock. */
+void
+inode_set_dir_index (struct inode *inode, struct dir_index *index) 
+{
+  inode->dir_index = index;
 }
 
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->data.length;
+  off_t length;
+
+  cache_read_at (inode->sector, &length, DISK_OFS (length), sizeof length);
+  return length;
+}
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED) 
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
 }
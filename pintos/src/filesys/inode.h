@@ -1,23 +1,38 @@
 #ifndef FILESYS_INODE_H
 #define FILESYS_INODE_H
 
+#include <iovec.h>
 #include <stdbool.h>
 #include "filesys/off_t.h"
-#include "devices/disk.h"
+#include "devices/block.h"
 
 struct bitmap;
+struct dir_index;
 
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
+bool inode_create_dir (disk_sector_t, off_t, disk_sector_t parent);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
+int inode_open_cnt (const struct inode *);
+bool inode_is_dir (const struct inode *);
+disk_sector_t inode_get_parent (const struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iov_cnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iov_cnt,
+                       off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
+void inode_lock_dir (struct inode *);
+void inode_unlock_dir (struct inode *);
+struct dir_index *inode_get_dir_index (const struct inode *);
+void inode_set_dir_index (struct inode *, struct dir_index *);
 off_t inode_length (const struct inode *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,356 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Operations that change metadata (inodes, index blocks,
+   directory contents, and the free map) are bracketed by
+   journal_begin() and journal_end().  Each sector they modify
+   is named to journal_log() before it is written, which holds
+   it in the buffer cache so that it cannot reach its home
+   location early.  The modifications of every operation that
+   has ended since the last commit form one transaction.
+
+   A commit writes the held sectors to the log, then writes the
+   header that lists them, which is the commit point, then writes
+   the sectors to their home locations, then clears the header.
+   If the system stops in between, journal_init() finds the
+   header and replays the log.
+
+   Many operations share each commit, which happens when the log
+   is nearly full, every JOURNAL_COMMIT_TICKS, and at shutdown.
+
+   File data is not journaled, but data sectors newly allocated
+   by the transaction, named to journal_order(), are written home
+   before the header, so that a committed pointer never leads to
+   a sector's old contents.  The free map is treated the same
+   way instead of being logged: writing it early can at worst
+   leak sectors that a crash leaves allocated, because sectors
+   released by a transaction are not reused until it commits
+   (see free_map_commit()). */
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Upper bound on the number of distinct sectors that a single
+   operation may log. */
+#define OP_MAX 8
+
+/* Number of sectors named to journal_order() that are kept
+   before they are written home early to make room. */
+#define ORDERED_MAX 32
+
+/* Ticks between commits when the log is not filling up. */
+#define JOURNAL_COMMIT_TICKS TIMER_FREQ
+
+/* On-disk journal header.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t cnt;                       /* Number of logged sectors. */
+    disk_sector_t sectors[JOURNAL_SIZE]; /* Home of each log sector. */
+    uint8_t unused[DISK_SECTOR_SIZE - 8 - 4 * JOURNAL_SIZE];
+  };
+
+/* Sectors logged by the running transaction. */
+static disk_sector_t logged[JOURNAL_SIZE];
+static size_t logged_cnt;
+
+/* Sectors to write home before the running transaction
+   commits. */
+static disk_sector_t ordered[ORDERED_MAX];
+static size_t ordered_cnt;
+
+/* Contents of the log area, so that it can be read or written
+   with a single disk command.  Used only by the committing
+   thread and by recovery. */
+static uint8_t log_buffer[JOURNAL_SIZE][DISK_SECTOR_SIZE];
+
+static int outstanding;                 /* Operations in progress. */
+static bool committing;                 /* Commit in progress? */
+static bool commit_wanted;              /* Commit once idle? */
+static struct thread *committer;        /* Thread doing the commit. */
+static struct lock journal_lock;        /* Protects all of the above. */
+static struct condition journal_cond;   /* Signaled after a commit. */
+
+static void add_ordered (disk_sector_t);
+static void write_header (size_t cnt);
+static void recover (void);
+static void commit (void);
+static thread_func journal_daemon NO_RETURN;
+
+/* Initializes the journal and starts its commit thread.  If
+   FORMAT is true, writes an empty journal; otherwise, replays
+   any transaction that committed before the last shutdown.
+   Must be called before the free map is read. */
+void
+journal_init (bool format) 
+{
+  ASSERT (sizeof (struct journal_header) == DISK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+  if (format)
+    write_header (0);
+  else
+    recover ();
+
+  thread_create ("journal", PRI_DEFAULT, journal_daemon, NULL);
+}
+
+/* Commits the running transaction, including the free map. */
+void
+journal_done (void) 
+{
+  journal_begin ();
+  lock_acquire (&journal_lock);
+  commit_wanted = true;
+  lock_release (&journal_lock);
+  journal_end ();
+}
+
+/* Starts an operation that modifies metadata.  Waits, if
+   necessary, until the running transaction has room for it.
+   Operations nest; only the outermost one can wait. */
+void
+journal_begin (void) 
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  while (committing
+         || logged_cnt + (outstanding + 1) * OP_MAX > JOURNAL_SIZE)
+    {
+      if (!committing && outstanding == 0)
+        commit ();
+      else 
+        {
+          commit_wanted = true;
+          cond_wait (&journal_cond, &journal_lock);
+        }
+    }
+  outstanding++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started by journal_begin().  The last
+   operation to end commits the transaction if a commit is
+   wanted. */
+void
+journal_end (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (outstanding > 0);
+  if (--outstanding == 0 && commit_wanted && !committing)
+    commit ();
+  lock_release (&journal_lock);
+}
+
+/* Adds SECTOR to the running transaction, if the caller is in an
+   operation, and holds it in the buffer cache until the
+   transaction commits.  Must be called before SECTOR is
+   modified.  If LOAD is false, the caller is about to overwrite
+   all of SECTOR, so it need not be read from disk.  Writes made
+   outside of any operation, as during formatting, are not
+   journaled. */
+void
+journal_log (disk_sector_t sector, bool load) 
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  /* The free map, written by commit() itself, is ordered rather
+     than logged. */
+  if (committing && committer == t) 
+    {
+      add_ordered (sector);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  if (t->journal_depth == 0) 
+    {
+      lock_release (&journal_lock);
+      return;
+    }
+  for (i = 0; i < logged_cnt; i++)
+    if (logged[i] == sector) 
+      {
+        lock_release (&journal_lock);
+        return;
+      }
+
+  /* journal_begin() leaves room for OP_MAX sectors per
+     operation, so only an operation that logs more can get
+     here. */
+  if (logged_cnt >= JOURNAL_SIZE)
+    PANIC ("journal overflow: operation logged over %d sectors", OP_MAX);
+  logged[logged_cnt++] = sector;
+  lock_release (&journal_lock);
+
+  cache_hold (sector, load);
+}
+
+/* Records that SECTOR, a file data sector newly allocated by the
+   caller's operation, must reach disk before the running
+   transaction commits.  Outside of any operation, does
+   nothing. */
+void
+journal_order (disk_sector_t sector) 
+{
+  if (thread_current ()->journal_depth > 0)
+    add_ordered (sector);
+}
+
+/* Adds SECTOR to `ordered', unless it is there already.  If
+   `ordered' is full, first writes the sectors already there
+   home, which is never too early. */
+static void
+add_ordered (disk_sector_t sector) 
+{
+  disk_sector_t full[ORDERED_MAX];
+  size_t full_cnt = 0;
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < ordered_cnt; i++)
+    if (ordered[i] == sector) 
+      {
+        lock_release (&journal_lock);
+        return;
+      }
+  if (ordered_cnt >= ORDERED_MAX) 
+    {
+      memcpy (full, ordered, sizeof ordered);
+      full_cnt = ordered_cnt;
+      ordered_cnt = 0;
+    }
+  ordered[ordered_cnt++] = sector;
+  lock_release (&journal_lock);
+
+  if (full_cnt > 0)
+    cache_write_back (full, full_cnt);
+}
+
+/* Writes a journal header that lists the first CNT sectors of
+   `logged'. */
+static void
+write_header (size_t cnt) 
+{
+  static struct journal_header header;
+
+  ASSERT (cnt <= JOURNAL_SIZE);
+  memset (&header, 0, sizeof header);
+  header.magic = JOURNAL_MAGIC;
+  header.cnt = cnt;
+  memcpy (header.sectors, logged, cnt * sizeof *logged);
+  block_write (filesys_disk, JOURNAL_SECTOR, &header);
+}
+
+/* Replays the committed transaction in the journal, if any. */
+static void
+recover (void) 
+{
+  static struct journal_header header;
+  size_t i;
+
+  block_read (filesys_disk, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC || header.cnt > JOURNAL_SIZE)
+    PANIC ("file system journal is corrupt");
+  if (header.cnt == 0)
+    return;
+
+  block_read_multiple (filesys_disk, JOURNAL_SECTOR + 1, header.cnt,
+                       log_buffer);
+  for (i = 0; i < header.cnt; i++) 
+    block_write (filesys_disk, header.sectors[i], log_buffer[i]);
+  logged_cnt = 0;
+  write_header (0);
+}
+
+/* Commits the running transaction.  The caller must hold
+   journal_lock, which is released during the I/O, and no
+   operation may be outstanding. */
+static void
+commit (void) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (outstanding == 0 && !committing);
+
+  committing = true;
+  committer = thread_current ();
+  commit_wanted = false;
+  lock_release (&journal_lock);
+
+  /* The free map's changes belong to the operations that just
+     finished.  Its sectors join `ordered'. */
+  free_map_flush ();
+
+  if (logged_cnt > 0) 
+    {
+      for (i = 0; i < logged_cnt; i++) 
+        cache_read (logged[i], log_buffer[i]);
+      block_write_multiple (filesys_disk, JOURNAL_SECTOR + 1, logged_cnt,
+                            log_buffer);
+    }
+
+  /* No operation is outstanding, so nothing else touches
+     `ordered' until the commit is done. */
+  cache_write_back (ordered, ordered_cnt);
+  ordered_cnt = 0;
+
+  if (logged_cnt > 0) 
+    {
+      write_header (logged_cnt);
+      for (i = 0; i < logged_cnt; i++)
+        cache_unhold (logged[i]);
+      write_header (0);
+    }
+
+  /* What the transaction released can be reused now that it has
+     committed. */
+  free_map_commit ();
+
+  lock_acquire (&journal_lock);
+  logged_cnt = 0;
+  committing = false;
+  committer = NULL;
+  cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Commits the running transaction periodically, so that work
+   done while the log is not filling up still reaches disk. */
+static void
+journal_daemon (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+      lock_acquire (&journal_lock);
+      if (outstanding == 0 && !committing)
+        commit ();
+      else
+        commit_wanted = true;
+      lock_release (&journal_lock);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Maximum number of metadata sectors in one transaction. */
+#define JOURNAL_SIZE 32
+
+/* Sectors reserved for the journal, starting at JOURNAL_SECTOR:
+   a header followed by JOURNAL_SIZE log sectors. */
+#define JOURNAL_SECTOR_CNT (1 + JOURNAL_SIZE)
+
+void journal_init (bool format);
+void journal_done (void);
+void journal_begin (void);
+void journal_end (void);
+void journal_log (disk_sector_t, bool load);
+void journal_order (disk_sector_t);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,14 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One segment of a vectored read or write, as passed to the
+   readv and writev system calls. */
+struct iovec
+  {
+    void *iov_base;             /* Start of segment. */
+    size_t iov_len;             /* Length of segment in bytes. */
+  };
+
+#endif /* lib/iovec.h */
@@ -6,9 +6,12 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void flush_line (void);
+static void write_devices (const char *, size_t);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -59,6 +62,26 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* Number of times output was written to the devices. */
+static int64_t flush_cnt;
+
+/* Line buffering.
+
+   Writing to the devices one character at a time is slow: each
+   character costs the serial driver an interrupt-disabled queue
+   operation and the VGA driver a cursor update, both of which
+   mean port I/O.  So each thread collects its output in
+   console_line in its struct thread, which needs no locking
+   because only that thread uses it, and writes it out a line at
+   a time, when the buffer fills, and when the outermost console
+   call returns.  The console lock is held throughout, so lines
+   are written in the order they were produced and output from
+   a single call is not mixed with other threads' output.
+
+   Output is written directly, without buffering, in interrupt
+   context, before console_init(), after a panic, and by nested
+   calls made while the thread's buffer is being written. */
+
 /* Enable console locking. */
 void
 console_init (void) 
@@ -73,6 +96,12 @@ console_init (void)
 void
 console_panic (void) 
 {
+  /* Write out whatever the panicking thread had buffered, so
+     that its last output precedes the panic message.  In an
+     interrupt handler, that is the interrupted thread's output;
+     the system is stopping, so it need not be left alone. */
+  if (use_console_lock && !thread_current ()->console_flushing)
+    flush_line ();
   use_console_lock = false;
 }
 
@@ -80,7 +109,8 @@ console_panic (void)
 void
 console_print_stats (void) 
 {
-  printf ("Console: %lld characters output\n", write_cnt);
+  printf ("Console: %lld characters output in %lld writes\n",
+          write_cnt, flush_cnt);
 }
 
 /* Acquires the console lock. */
@@ -104,8 +134,12 @@ release_console (void)
     {
       if (console_lock_depth > 0)
         console_lock_depth--;
-      else
-        lock_release (&console_lock); 
+      else 
+        {
+          if (!thread_current ()->console_flushing)
+            flush_line ();
+          lock_release (&console_lock); 
+        }
     }
 }
 
@@ -178,14 +212,55 @@ vprintf_helper (char c, void *char_cnt_)
   putchar_have_lock (c);
 }
 
-/* Writes C to the vga display and serial port.
+/* Writes C to the vga display and serial port, or to the
+   current thread's line buffer.
    The caller has already acquired the console lock if
    appropriate. */
 static void
 putchar_have_lock (uint8_t c) 
 {
+  struct thread *t;
+
   ASSERT (console_locked_by_current_thread ());
   write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  if (intr_context () || !use_console_lock
+      || thread_current ()->console_flushing) 
+    {
+      char ch = c;
+      write_devices (&ch, 1);
+      return;
+    }
+
+  t = thread_current ();
+  t->console_line[t->console_len++] = c;
+  if (c == '\n' || t->console_len >= sizeof t->console_line)
+    flush_line ();
+}
+
+/* Writes the current thread's buffered output to the vga display
+   and serial port.  The caller has already acquired the console
+   lock if appropriate. */
+static void
+flush_line (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (!t->console_flushing);
+  if (t->console_len > 0) 
+    {
+      t->console_flushing = true;
+      write_devices (t->console_line, t->console_len);
+      t->console_len = 0;
+      t->console_flushing = false;
+    }
+}
+
+/* Writes the N characters in BUFFER to the vga display and serial
+   port. */
+static void
+write_devices (const char *buffer, size_t n) 
+{
+  flush_cnt++;
+  serial_putbuf (buffer, n);
+  vga_putbuf (buffer, n);
 }
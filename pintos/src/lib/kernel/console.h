@@ -1,6 +1,9 @@
 #ifndef __LIB_KERNEL_CONSOLE_H
 #define __LIB_KERNEL_CONSOLE_H
 
+/* Size of each thread's console output buffer, in bytes. */
+#define CONSOLE_LINE_MAX 128
+
 void console_init (void);
 void console_panic (void);
 void console_print_stats (void);
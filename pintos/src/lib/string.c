@@ -1,5 +1,124 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* A 32-bit word that may alias objects of any type, for moving
+   and scanning memory a word at a time. */
+typedef uint32_t word_t __attribute__ ((may_alias));
+
+/* A word with each byte set to 1. */
+#define ONES 0x01010101u
+
+/* Returns nonzero if any byte in W is zero.  The lowest set bit
+   in the result is the top bit of the first (lowest-addressed)
+   zero byte, so first_byte() gives that byte's index.  Bits for
+   later bytes may be set spuriously, because of borrows.
+
+   Scanning a string a word at a time with this test never
+   faults as long as each word loaded is aligned: an aligned word
+   lies within one page, so if its first byte is readable then so
+   is its last. */
+static inline word_t
+has_zero (word_t w) 
+{
+  return (w - ONES) & ~w & (ONES << 7);
+}
+
+/* Returns the index of the byte of a word flagged by the lowest
+   set bit in MASK, which must be nonzero.  (x86 is
+   little-endian.) */
+static inline size_t
+first_byte (word_t mask) 
+{
+  return __builtin_ctz (mask) / 8;
+}
+
+/* Returns a pointer to the first C or null byte in STRING. */
+static const char *
+find_char_or_null (const char *string, char c) 
+{
+  word_t pattern = (unsigned char) c * ONES;
+  const word_t *w;
+
+  for (; (uintptr_t) string % 4 != 0; string++)
+    if (*string == c || *string == '\0')
+      return string;
+
+  for (w = (const word_t *) string; ; w++) 
+    {
+      word_t mask = has_zero (*w) | has_zero (*w ^ pattern);
+      if (mask != 0)
+        return (const char *) w + first_byte (mask);
+    }
+}
+
+/* Blocks of at least REP_MIN bytes are moved with the x86
+   `rep movsl' and `rep stosl' instructions, after aligning the
+   destination.  Their startup cost outweighs their speed for
+   shorter blocks, which are moved by a loop of word moves. */
+#define REP_MIN 64
+
+/* Copies SIZE bytes from SRC to DST, lowest address first.  Safe
+   for overlapping blocks only if DST < SRC. */
+static inline void
+copy_up (unsigned char *dst, const unsigned char *src, size_t size) 
+{
+  if (size >= REP_MIN) 
+    {
+      size_t cnt;
+
+      for (; (uintptr_t) dst % 4 != 0; size--)
+        *dst++ = *src++;
+      cnt = size / 4;
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+      size %= 4;
+    }
+  else
+    for (; size >= 4; size -= 4, dst += 4, src += 4)
+      *(word_t *) dst = *(const word_t *) src;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+/* Copies SIZE bytes from SRC to DST, highest address first.  Safe
+   for overlapping blocks only if DST > SRC. */
+static inline void
+copy_down (unsigned char *dst, const unsigned char *src, size_t size) 
+{
+  dst += size;
+  src += size;
+  if (size >= REP_MIN) 
+    {
+      size_t cnt;
+
+      for (; (uintptr_t) dst % 4 != 0; size--)
+        *--dst = *--src;
+      cnt = size / 4;
+
+      /* With the direction flag set, the string instructions
+         work downward from the last word.  Interrupt entry
+         clears the flag, so handlers are unaffected. */
+      dst -= 4;
+      src -= 4;
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+      dst += 4;
+      src += 4;
+      size %= 4;
+    }
+  else
+    for (; size >= 4; size -= 4) 
+      {
+        dst -= 4;
+        src -= 4;
+        *(word_t *) dst = *(const word_t *) src;
+      }
+
+  while (size-- > 0)
+    *--dst = *--src;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,9 +131,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
-
+  copy_up (dst, src, size);
   return dst_;
 }
 
@@ -29,20 +146,12 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+  if (dst < src || dst >= src + size)
+    copy_up (dst, src, size);
+  else if (dst > src)
+    copy_down (dst, src, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -78,6 +187,53 @@ strcmp (const char *a_, const char *b_)
   ASSERT (a != NULL);
   ASSERT (b != NULL);
 
+  /* Align A, then compare a word at a time.  Words of B are
+     loaded aligned as well, and if B's alignment differs from
+     A's, each word compared is spliced from two of them.  The
+     second is loaded only once the first is known not to end B.
+     The byte loop at the end finds the difference, if any, within
+     the last words compared. */
+  for (; (uintptr_t) a % 4 != 0; a++, b++)
+    if (*a == '\0' || *a != *b)
+      return *a < *b ? -1 : *a > *b;
+  if ((uintptr_t) b % 4 == 0) 
+    {
+      const word_t *wa = (const word_t *) a;
+      const word_t *wb = (const word_t *) b;
+
+      while (*wa == *wb && !has_zero (*wa)) 
+        {
+          wa++;
+          wb++;
+        }
+      a = (const unsigned char *) wa;
+      b = (const unsigned char *) wb;
+    }
+  else 
+    {
+      unsigned shift = (uintptr_t) b % 4 * 8;
+      const word_t *wa = (const word_t *) a;
+      const word_t *wb = (const word_t *) (b - (uintptr_t) b % 4);
+      word_t lo = *wb;
+
+      for (;;) 
+        {
+          word_t hi;
+
+          if (has_zero ((lo >> shift) | (~0u << (32 - shift))))
+            break;
+          hi = wb[1];
+          if (*wa != ((lo >> shift) | (hi << (32 - shift)))
+              || has_zero (*wa))
+            break;
+          wa++;
+          wb++;
+          lo = hi;
+        }
+      b += (const unsigned char *) wa - a;
+      a = (const unsigned char *) wa;
+    }
+
   while (*a != '\0' && *a == *b) 
     {
       a++;
@@ -95,9 +251,21 @@ memchr (const void *block_, int ch_, size_t size)
 {
   const unsigned char *block = block_;
   unsigned char ch = ch_;
+  word_t pattern = ch * ONES;
 
   ASSERT (block != NULL || size == 0);
 
+  for (; size > 0 && (uintptr_t) block % 4 != 0; size--, block++)
+    if (*block == ch)
+      return (void *) block;
+
+  for (; size >= 4; size -= 4, block += 4) 
+    {
+      word_t mask = has_zero (*(const word_t *) block ^ pattern);
+      if (mask != 0)
+        return (void *) (block + first_byte (mask));
+    }
+
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -116,13 +284,8 @@ strchr (const char *string, int c_)
 
   ASSERT (string != NULL);
 
-  for (;;) 
-    if (*string == c)
-      return (char *) string;
-    else if (*string == '\0')
-      return NULL;
-    else
-      string++;
+  string = find_char_or_null (string, c);
+  return *string == c ? (char *) string : NULL;
 }
 
 /* Returns the length of the initial substring of STRING that
@@ -260,10 +423,15 @@ strtok_r (char *s, const char *delimiters, char **save_ptr)
       s++;
     }
 
-  /* Skip any non-DELIMITERS up to the end of the string. */
+  /* Skip any non-DELIMITERS up to the end of the string.  A
+     single delimiter, the common case, is found a word at a
+     time. */
   token = s;
-  while (strchr (delimiters, *s) == NULL)
-    s++;
+  if (delimiters[0] != '\0' && delimiters[1] == '\0')
+    s = (char *) find_char_or_null (s, delimiters[0]);
+  else
+    while (strchr (delimiters, *s) == NULL)
+      s++;
   if (*s != '\0') 
     {
       *s = '\0';
@@ -279,9 +447,25 @@ void *
 memset (void *dst_, int value, size_t size) 
 {
   unsigned char *dst = dst_;
+  word_t word = (unsigned char) value * 0x01010101u;
 
   ASSERT (dst != NULL || size == 0);
-  
+
+  if (size >= REP_MIN) 
+    {
+      size_t cnt;
+
+      for (; (uintptr_t) dst % 4 != 0; size--)
+        *dst++ = value;
+      cnt = size / 4;
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (cnt) : "a" (word) : "memory");
+      size %= 4;
+    }
+  else
+    for (; size >= 4; size -= 4, dst += 4)
+      *(word_t *) dst = word;
+
   while (size-- > 0)
     *dst++ = value;
 
@@ -293,12 +477,20 @@ size_t
 strlen (const char *string) 
 {
   const char *p;
+  const word_t *w;
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
-  return p - string;
+  for (p = string; (uintptr_t) p % 4 != 0; p++)
+    if (*p == '\0')
+      return p - string;
+
+  for (w = (const word_t *) p; ; w++) 
+    {
+      word_t mask = has_zero (*w);
+      if (mask != 0)
+        return (const char *) w + first_byte (mask) - string;
+    }
 }
 
 /* If STRING is less than MAXLEN characters in length, returns
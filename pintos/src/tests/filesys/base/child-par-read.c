@@ -0,0 +1,49 @@
+/* Child process for par-read test.
+   Reads its own test file from start to end several times, one
+   sector-sized block at a time, and verifies the contents. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+const char *test_name = "child-par-read";
+
+static char buf[BUF_SIZE];
+static char block[512];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  int pass;
+  size_t ofs;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "data%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < sizeof buf; ofs += sizeof block) 
+        {
+          CHECK (read (fd, block, sizeof block) == sizeof block,
+                 "read \"%s\"", file_name);
+          compare_bytes (block, buf + ofs, sizeof block, ofs, file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,64 @@
+/* Creates 5,000 empty files in the root directory, then opens
+   each of them twice, in reverse and in forward order, and
+   checks that names not in the directory are not found.  The
+   run time is dominated by directory lookups, so it measures
+   how lookup cost grows with directory size. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 5000
+
+/* Stores the name of file number I into NAME. */
+static void
+file_name (char name[16], int i) 
+{
+  snprintf (name, 16, "f%d", i);
+}
+
+/* Opens and closes file number I, failing if it is missing. */
+static void
+open_file (int i) 
+{
+  char name[16];
+  int fd;
+
+  file_name (name, i);
+  fd = open (name);
+  if (fd < 2)
+    fail ("open \"%s\" failed", name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int i;
+
+  msg ("creating %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      file_name (name, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  msg ("opening files in reverse order");
+  for (i = FILE_CNT - 1; i >= 0; i--)
+    open_file (i);
+
+  msg ("opening files in order");
+  for (i = 0; i < FILE_CNT; i++)
+    open_file (i);
+
+  msg ("looking up missing files");
+  for (i = FILE_CNT; i < 2 * FILE_CNT; i++) 
+    {
+      file_name (name, i);
+      if (open (name) != -1)
+        fail ("open \"%s\" should have failed", name);
+    }
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-dir) begin
+(lg-dir) creating 5000 files
+(lg-dir) opening files in reverse order
+(lg-dir) opening files in order
+(lg-dir) looking up missing files
+(lg-dir) end
+EOF
+pass;
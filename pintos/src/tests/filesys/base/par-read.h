@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#define CHILD_CNT 4
+#define BUF_SIZE 8192
+#define PASS_CNT 8
+
+#endif /* tests/filesys/base/par-read.h */
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($dir) = {};
+my ($root) = {"d0" => $dir};
+for (my ($i) = 1; $i < 12; $i++) {
+    $dir = $dir->{"d$i"} = {};
+}
+$dir->{"file"} = ["deep\n"];
+check_archive ($root);
+pass;
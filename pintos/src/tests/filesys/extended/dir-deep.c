@@ -0,0 +1,60 @@
+/* Creates a file at the bottom of a chain of 12 nested
+   directories, then opens it 1,000 times by its absolute path
+   and 1,000 times by a relative path that climbs out of and back
+   into the chain with "..".  Each open walks every component of
+   the path, so the run time measures path lookup latency. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 12
+#define OPEN_CNT 1000
+
+/* Opens PATH OPEN_CNT times, checking that it is always the file
+   with inode number EXPECTED. */
+static void
+open_repeatedly (const char *path, int expected) 
+{
+  int i;
+
+  msg ("open \"%s\" %d times", path, OPEN_CNT);
+  for (i = 0; i < OPEN_CNT; i++) 
+    {
+      int fd = open (path);
+      if (fd < 2)
+        fail ("open \"%s\" failed", path);
+      if (inumber (fd) != expected)
+        fail ("\"%s\" has the wrong inode number", path);
+      close (fd);
+    }
+}
+
+void
+test_main (void) 
+{
+  char path[128] = "";
+  int fd, ino;
+  int i;
+
+  for (i = 0; i < DEPTH; i++) 
+    {
+      snprintf (path + strlen (path), sizeof path - strlen (path),
+                "/d%d", i);
+      CHECK (mkdir (path), "mkdir \"%s\"", path);
+    }
+  strlcat (path, "/file", sizeof path);
+  CHECK (create (path, 0), "create \"%s\"", path);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+  CHECK (write (fd, "deep\n", 5) == 5, "write \"%s\"", path);
+  ino = inumber (fd);
+  msg ("close \"%s\"", path);
+  close (fd);
+
+  open_repeatedly (path, ino);
+
+  CHECK (chdir ("/d0/d1/d2/d3/d4/d5"), "chdir \"/d0/d1/d2/d3/d4/d5\"");
+  open_repeatedly ("../../d4/d5/d6/./d7/d8/d9/d10/d11/file", ino);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-deep) begin
+(dir-deep) mkdir "/d0"
+(dir-deep) mkdir "/d0/d1"
+(dir-deep) mkdir "/d0/d1/d2"
+(dir-deep) mkdir "/d0/d1/d2/d3"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6/d7"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6/d7/d8"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10"
+(dir-deep) mkdir "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11"
+(dir-deep) create "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11/file"
+(dir-deep) open "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11/file"
+(dir-deep) write "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11/file"
+(dir-deep) close "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11/file"
+(dir-deep) open "/d0/d1/d2/d3/d4/d5/d6/d7/d8/d9/d10/d11/file" 1000 times
+(dir-deep) chdir "/d0/d1/d2/d3/d4/d5"
+(dir-deep) open "../../d4/d5/d6/./d7/d8/d9/d10/d11/file" 1000 times
+(dir-deep) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Grows a file from 0 bytes to 512 kB, 512 bytes at a time, far
+   enough to need the indirect and doubly indirect blocks, then
+   reads it back.  Every write extends the file, so the run time
+   measures append throughput. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 512
+#define BLOCK_CNT 1024
+
+static char block[BLOCK_SIZE];
+static char expected[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testme";
+  size_t i;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("appending to \"%s\"", file_name);
+  random_init (0);
+  for (i = 0; i < BLOCK_CNT; i++) 
+    {
+      random_bytes (block, sizeof block);
+      if (write (fd, block, sizeof block) != sizeof block)
+        fail ("write %d bytes at offset %zu in \"%s\" failed",
+              BLOCK_SIZE, i * BLOCK_SIZE, file_name);
+    }
+  CHECK (filesize (fd) == BLOCK_SIZE * BLOCK_CNT,
+         "filesize \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\" for verification",
+         file_name);
+  random_init (0);
+  for (i = 0; i < BLOCK_CNT; i++) 
+    {
+      random_bytes (expected, sizeof expected);
+      if (read (fd, block, sizeof block) != sizeof block)
+        fail ("read %d bytes at offset %zu in \"%s\" failed",
+              BLOCK_SIZE, i * BLOCK_SIZE, file_name);
+      compare_bytes (block, expected, sizeof block, i * BLOCK_SIZE,
+                     file_name);
+    }
+  msg ("verified contents of \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
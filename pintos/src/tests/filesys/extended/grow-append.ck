@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append) begin
+(grow-append) create "testme"
+(grow-append) open "testme"
+(grow-append) appending to "testme"
+(grow-append) filesize "testme"
+(grow-append) close "testme"
+(grow-append) open "testme" for verification
+(grow-append) verified contents of "testme"
+(grow-append) close "testme"
+(grow-append) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Creates a 4 MB file, twice the size of the file system disk,
+   which only works if creating a file does not allocate its
+   data.  Checks that the file reads back as zeros, writes into
+   the middle of it, and then removes it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (4 * 1024 * 1024)
+
+static char buf[512];
+static const char marker[] = "middle";
+
+/* Reads sizeof buf bytes at OFS in FD and checks that they are
+   zeros. */
+static void
+check_zeros (int fd, int ofs) 
+{
+  size_t i;
+
+  seek (fd, ofs);
+  CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+         "read %zu bytes at offset %d", sizeof buf, ofs);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu at offset %d is nonzero", i, ofs);
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "big";
+  int fd;
+
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\"", file_name);
+  check_zeros (fd, 0);
+  check_zeros (fd, FILE_SIZE / 2);
+  check_zeros (fd, FILE_SIZE - sizeof buf);
+
+  seek (fd, FILE_SIZE / 2);
+  CHECK (write (fd, marker, sizeof marker) == sizeof marker,
+         "write \"%s\"", file_name);
+  seek (fd, FILE_SIZE / 2);
+  CHECK (read (fd, buf, sizeof marker) == sizeof marker,
+         "read \"%s\"", file_name);
+  if (memcmp (buf, marker, sizeof marker))
+    fail ("data written to \"%s\" did not read back", file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-create-lg) begin
+(grow-create-lg) create "big"
+(grow-create-lg) open "big"
+(grow-create-lg) filesize "big"
+(grow-create-lg) read 512 bytes at offset 0
+(grow-create-lg) read 512 bytes at offset 2097152
+(grow-create-lg) read 512 bytes at offset 4193792
+(grow-create-lg) write "big"
+(grow-create-lg) read "big"
+(grow-create-lg) close "big"
+(grow-create-lg) remove "big"
+(grow-create-lg) end
+EOF
+pass;
@@ -0,0 +1,205 @@
+/* Test program for the string scanning functions in
+   lib/string.c.
+
+   strlen(), strcmp(), memchr(), strchr(), and strtok_r() scan a
+   word at a time.  This program compares them against simple
+   byte-at-a-time versions on random strings at every alignment,
+   including strings that end at the last byte of a page.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Number of random trials. */
+#define TRIALS 100000
+
+/* Maximum string length tested. */
+#define MAX_LEN 40
+
+/* A page, so that strings can be placed to end at its last
+   byte.  Two strings are placed at once, one in each half. */
+static char page[4096] __attribute__ ((aligned (4096)));
+
+static char *random_string (char *end, size_t len);
+static int sign (int);
+static size_t ref_strlen (const char *);
+static int ref_strcmp (const char *, const char *);
+static const void *ref_memchr (const void *, int, size_t);
+static const char *ref_strchr (const char *, int);
+static void test_strtok_r (const char *, const char *delimiters);
+
+/* Fuzz the string scanning functions. */
+void
+test (void)
+{
+  static const char *delimiters[] = {"a", "ab", " ", ""};
+  int i;
+
+  printf ("testing string functions:");
+  for (i = 0; i < TRIALS; i++)
+    {
+      char *a, *b;
+      size_t a_len, b_len, n;
+      int c;
+
+      /* Make A end at or just before the end of the page, and B
+         end at or just before the middle, at any alignment. */
+      a_len = random_ulong () % (MAX_LEN + 1);
+      a = random_string (page + sizeof page - random_ulong () % 5, a_len);
+      b_len = random_ulong () % (MAX_LEN + 1);
+      b = random_string (page + sizeof page / 2 - random_ulong () % 5, b_len);
+
+      /* Often make B share a prefix with A, or equal it but for
+         one character, so that comparisons go past the first
+         word. */
+      switch (random_ulong () % 3)
+        {
+        case 0:
+          n = a_len < b_len ? a_len : b_len;
+          memcpy (b, a, random_ulong () % (n + 1));
+          break;
+        case 1:
+          b = page + sizeof page / 2 - a_len - 1 - random_ulong () % 5;
+          strlcpy (b, a, a_len + 1);
+          if (a_len > 0)
+            b[random_ulong () % a_len] ^= random_ulong () % 2;
+          break;
+        }
+
+      ASSERT (strlen (a) == ref_strlen (a));
+      ASSERT (strlen (b) == ref_strlen (b));
+      ASSERT (sign (strcmp (a, b)) == sign (ref_strcmp (a, b)));
+      ASSERT (sign (strcmp (b, a)) == sign (ref_strcmp (b, a)));
+
+      c = "abcd"[random_ulong () % 5];
+      n = random_ulong () % (a_len + 1);
+      ASSERT (memchr (a, c, n) == ref_memchr (a, c, n));
+      ASSERT (strchr (a, c) == ref_strchr (a, c));
+
+      test_strtok_r (a, delimiters[random_ulong () % 4]);
+
+      if (i % (TRIALS / 10) == 0)
+        printf (" %d", i);
+    }
+
+  printf (" done\n");
+  printf ("string: PASS\n");
+}
+
+/* Fills the LEN bytes before END, less one, with random
+   characters from a small alphabet, followed by a null
+   terminator, and returns the start of the string. */
+static char *
+random_string (char *end, size_t len)
+{
+  char *s = end - len - 1;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    s[i] = "abc "[random_ulong () % 4];
+  s[len] = '\0';
+  return s;
+}
+
+/* Returns the sign of X. */
+static int
+sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+/* Returns the length of S, a byte at a time. */
+static size_t
+ref_strlen (const char *s)
+{
+  size_t len = 0;
+
+  while (s[len] != '\0')
+    len++;
+  return len;
+}
+
+/* Compares A and B, a byte at a time. */
+static int
+ref_strcmp (const char *a_, const char *b_)
+{
+  const unsigned char *a = (const unsigned char *) a_;
+  const unsigned char *b = (const unsigned char *) b_;
+
+  for (; *a != '\0' && *a == *b; a++, b++)
+    continue;
+  return *a - *b;
+}
+
+/* Finds C in the SIZE bytes at BLOCK, a byte at a time. */
+static const void *
+ref_memchr (const void *block_, int c, size_t size)
+{
+  const unsigned char *block = block_;
+
+  for (; size > 0; size--, block++)
+    if (*block == (unsigned char) c)
+      return block;
+  return NULL;
+}
+
+/* Finds C in S, a byte at a time. */
+static const char *
+ref_strchr (const char *s, int c)
+{
+  for (;; s++)
+    if (*s == c)
+      return s;
+    else if (*s == '\0')
+      return NULL;
+}
+
+/* Returns true if C is in DELIMITERS. */
+static bool
+is_delimiter (char c, const char *delimiters)
+{
+  for (; *delimiters != '\0'; delimiters++)
+    if (c == *delimiters)
+      return true;
+  return false;
+}
+
+/* Tokenizes a copy of S with strtok_r() and checks each token
+   against a byte-at-a-time scan of S. */
+static void
+test_strtok_r (const char *s, const char *delimiters)
+{
+  char copy[MAX_LEN + 1];
+  char *token, *save_ptr;
+  size_t ofs = 0;
+
+  strlcpy (copy, s, sizeof copy);
+  for (token = strtok_r (copy, delimiters, &save_ptr); ;
+       token = strtok_r (NULL, delimiters, &save_ptr))
+    {
+      size_t len;
+
+      while (s[ofs] != '\0' && is_delimiter (s[ofs], delimiters))
+        ofs++;
+      if (s[ofs] == '\0')
+        {
+          ASSERT (token == NULL);
+          break;
+        }
+
+      ASSERT (token == copy + ofs);
+      for (len = 0; s[ofs + len] != '\0'
+                    && !is_delimiter (s[ofs + len], delimiters); len++)
+        ASSERT (token[len] == s[ofs + len]);
+      ASSERT (token[len] == '\0');
+      ofs += len;
+    }
+}
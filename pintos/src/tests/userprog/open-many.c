@@ -0,0 +1,50 @@
+/* Opens "sample.txt" many times, then repeatedly opens and closes
+   it 10,000 more times.  Every open must return the lowest file
+   descriptor not currently in use, so closed descriptors are
+   reused and the fd table does not keep growing.  The per-call
+   cost should stay flat no matter how many files are open. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HELD_CNT 128
+#define LOOP_CNT 10000
+
+void
+test_main (void) 
+{
+  int handles[HELD_CNT];
+  int fd;
+  int i;
+
+  msg ("open \"sample.txt\" %d times", HELD_CNT);
+  for (i = 0; i < HELD_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open() #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open() #%d returned %d after %d", i, handles[i],
+              handles[i - 1]);
+    }
+
+  msg ("close and reopen a handle in the middle");
+  close (handles[HELD_CNT / 2]);
+  fd = open ("sample.txt");
+  if (fd != handles[HELD_CNT / 2])
+    fail ("reopen returned %d instead of %d", fd, handles[HELD_CNT / 2]);
+
+  msg ("open and close \"sample.txt\" %d times", LOOP_CNT);
+  for (i = 0; i < LOOP_CNT; i++)
+    {
+      fd = open ("sample.txt");
+      if (fd != handles[HELD_CNT - 1] + 1)
+        fail ("open() #%d returned %d instead of %d", i, fd,
+              handles[HELD_CNT - 1] + 1);
+      close (fd);
+    }
+
+  for (i = 0; i < HELD_CNT; i++)
+    close (handles[i]);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" 128 times
+(open-many) close and reopen a handle in the middle
+(open-many) open and close "sample.txt" 10000 times
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Reads "sample.txt" backward in chunks with pread, then writes
+   a new file backward in chunks with pwrite, checking that
+   neither moves the file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 50
+
+static char buf[sizeof sample];
+
+void
+test_main (void) 
+{
+  int handle;
+  int ofs;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  msg ("pread \"sample.txt\" backward");
+  for (ofs = (sizeof sample - 2) / CHUNK_SIZE * CHUNK_SIZE; ofs >= 0;
+       ofs -= CHUNK_SIZE) 
+    {
+      int size = sizeof sample - 1 - ofs;
+      if (size > CHUNK_SIZE)
+        size = CHUNK_SIZE;
+      if (pread (handle, buf + ofs, size, ofs) != size)
+        fail ("pread of %d bytes at offset %d failed", size, ofs);
+    }
+  if (memcmp (buf, sample, sizeof sample - 1))
+    fail ("pread data differs from \"sample.txt\"");
+  if (tell (handle) != 0)
+    fail ("pread moved the file position to %u", tell (handle));
+  close (handle);
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  msg ("pwrite \"test.txt\" backward");
+  for (ofs = (sizeof sample - 2) / CHUNK_SIZE * CHUNK_SIZE; ofs >= 0;
+       ofs -= CHUNK_SIZE) 
+    {
+      int size = sizeof sample - 1 - ofs;
+      if (size > CHUNK_SIZE)
+        size = CHUNK_SIZE;
+      if (pwrite (handle, sample + ofs, size, ofs) != size)
+        fail ("pwrite of %d bytes at offset %d failed", size, ofs);
+    }
+  if (tell (handle) != 0)
+    fail ("pwrite moved the file position to %u", tell (handle));
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,82 @@
+/* Writes "test.txt" from three segments with writev and reads it
+   back into four differently sized segments with readv. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Sizes of the segments read into.  The last is longer than what
+   is left of the file, so the read ends partway through it. */
+#define SEG0 1
+#define SEG1 100
+#define SEG3 200
+
+/* The segments, in order, with a guard byte after each of the
+   first two so that data put in the wrong place is noticed. */
+static char buf[SEG0 + 1 + SEG1 + 1 + SEG3];
+
+/* Fails unless the SIZE bytes at P all equal 'x'. */
+static void
+check_untouched (const char *p, size_t size, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != 'x')
+      fail ("readv changed byte %zu of %s", i, what);
+}
+
+void
+test_main (void) 
+{
+  struct iovec out[3], in[4];
+  char *seg0 = buf;
+  char *seg1 = seg0 + SEG0 + 1;
+  char *seg3 = seg1 + SEG1 + 1;
+  size_t tail = sizeof sample - 1 - SEG0 - SEG1;
+  int handle, byte_cnt;
+
+  out[0].iov_base = sample;
+  out[0].iov_len = 10;
+  out[1].iov_base = sample + 10;
+  out[1].iov_len = 0;
+  out[2].iov_base = sample + 10;
+  out[2].iov_len = sizeof sample - 1 - 10;
+
+  in[0].iov_base = seg0;
+  in[0].iov_len = SEG0;
+  in[1].iov_base = seg1;
+  in[1].iov_len = SEG1;
+  in[2].iov_base = NULL;
+  in[2].iov_len = 0;
+  in[3].iov_base = seg3;
+  in[3].iov_len = SEG3;
+  memset (buf, 'x', sizeof buf);
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  byte_cnt = writev (handle, out, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("writev() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+
+  /* The file fills the first two segments and part of the last,
+     skipping the empty third. */
+  msg ("readv \"test.txt\"");
+  seek (handle, 0);
+  byte_cnt = readv (handle, in, 4);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (seg0, sample, SEG0))
+    fail ("readv data in segment 0 differs from what writev wrote");
+  if (memcmp (seg1, sample + SEG0, SEG1))
+    fail ("readv data in segment 1 differs from what writev wrote");
+  if (memcmp (seg3, sample + SEG0 + SEG1, tail))
+    fail ("readv data in segment 3 differs from what writev wrote");
+  check_untouched (seg0 + SEG0, 1, "the guard after segment 0");
+  check_untouched (seg1 + SEG1, 1, "the guard after segment 1");
+  check_untouched (seg3 + tail, SEG3 - tail, "segment 3 past end of file");
+  if (tell (handle) != sizeof sample - 1)
+    fail ("readv left the file position at %u", tell (handle));
+}
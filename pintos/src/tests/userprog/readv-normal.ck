@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-normal) begin
+(readv-normal) create "test.txt"
+(readv-normal) open "test.txt"
+(readv-normal) readv "test.txt"
+(readv-normal) end
+readv-normal: exit(0)
+EOF
+pass;
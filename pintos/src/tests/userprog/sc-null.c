@@ -0,0 +1,28 @@
+/* Issues a long run of system calls that do almost no work in
+   the kernel, so that the run time is dominated by system call
+   entry, argument fetching and dispatch.  Each seek() is checked
+   with a matching tell() so the loop also verifies that one- and
+   two-argument calls get their arguments right. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LOOP_CNT 100000
+
+void
+test_main (void) 
+{
+  int handle;
+  unsigned i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  msg ("seek and tell %d times", LOOP_CNT);
+  for (i = 0; i < LOOP_CNT; i++)
+    {
+      seek (handle, i);
+      if (tell (handle) != i)
+        fail ("tell() returned %u after seek to %u", tell (handle), i);
+    }
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sc-null) begin
+(sc-null) open "sample.txt"
+(sc-null) seek and tell 100000 times
+(sc-null) end
+sc-null: exit(0)
+EOF
+pass;
@@ -30,7 +30,9 @@
 #include "tests/threads/tests.h"
 #endif
 #ifdef FILESYS
+#include "devices/block.h"
 #include "devices/disk.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -44,6 +46,10 @@ uint32_t *base_page_dir;
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
+
+/* -ramdisk: Size in kB of a RAM disk for the file system, or 0
+   to use hd0:1. */
+static size_t ramdisk_kb;
 #endif
 
 /* -q: Power off after kernel tasks complete? */
@@ -111,7 +117,10 @@ main (void)
 
 #ifdef FILESYS
   /* Initialize file system. */
+  block_init ();
   disk_init ();
+  if (ramdisk_kb > 0)
+    ramdisk_init (ramdisk_kb);
   filesys_init (format_filesys);
 #endif
 
@@ -239,6 +248,14 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-pio"))
+        disk_pio_only = true;
+      else if (!strcmp (name, "-ramdisk")) 
+        {
+          /* A new RAM disk holds no file system yet. */
+          ramdisk_kb = atoi (value);
+          format_filesys = true;
+        }
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -293,6 +310,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"put", 2, fsutil_put},
       {"get", 2, fsutil_get},
+      {"copybench", 1, fsutil_copybench},
 #endif
       {NULL, 0, NULL},
     };
@@ -342,11 +360,16 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  put FILE           Put FILE into file system from scratch disk.\n"
           "  get FILE           Get FILE from file system into scratch disk.\n"
+          "  copybench          Benchmark copying across disk channels.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
           "  -q                 Power off VM after actions or on panic.\n"
           "  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+          "  -pio               Do not use DMA for disk transfers.\n"
+          "  -ramdisk=KB        Keep file system on a KB-kB RAM disk.\n"
+#endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
@@ -388,9 +411,11 @@ print_stats (void)
   timer_print_stats ();
   thread_print_stats ();
 #ifdef FILESYS
+  block_print_stats ();
   disk_print_stats ();
 #endif
   console_print_stats ();
+  serial_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
@@ -15,7 +15,9 @@
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
+#include "filesys/directory.h"
 #include "filesys/file.h"
+#include "threads/malloc.h"
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -36,6 +38,12 @@ static struct list sleeping_list;
 #ifdef USERPROG
 /* List of all processes. */
 static struct thread * threads[THD_CNT];
+
+/* File descriptors 0 and 1 are the console, so the first file
+   opened gets FD_MIN.  A process's fd table starts with
+   FD_TABLE_INIT slots and doubles each time it fills up. */
+#define FD_MIN 2
+#define FD_TABLE_INIT 16
 #endif
 
 /* Idle thread. */
@@ -213,6 +221,10 @@ thread_create (const char *name, int priority,
   #ifdef USERPROG
   /* Add to threads. */
   threads[tid] = t;
+  
+  /* Inherit the working directory. */
+  if (thread_current ()->cwd != NULL)
+  	t->cwd = dir_reopen (thread_current ()->cwd);
   #endif
   
   /* Add to run queue. */
@@ -470,7 +482,7 @@ init_thread (struct thread *t, const char *name, int priority)
   
 #ifdef USERPROG
 	list_init (&t->children);
-	list_init (&t->open_files);
+	t->fd_free = FD_MIN;
 	sema_init (&t->sema_exec, 0);
 #endif
 
@@ -726,20 +738,83 @@ remove_thread (tid_t tid)
 	threads[tid] = NULL;
 }
 
-/* Get the file with given file descriptor. */
-struct file_elem *
-thread_get_file_elem (int fd)
+/* Installs FILE in the current process's fd table at the lowest
+   free descriptor and returns it, growing the table if it is
+   full.  Returns -1 if memory allocation fails. */
+int
+thread_add_file (struct file *file)
 {
 	struct thread *curr = thread_current ();
-	struct file_elem *file_elem = NULL;
-	struct file_elem *file_e;
-	struct list_elem *elem;
-	for (elem = list_begin (&curr->open_files); elem != list_end (&curr->open_files); elem = list_next (elem))
-		if ((file_e = list_entry (elem, struct file_elem, elem))->fd == fd)
-			{
-				file_elem = file_e;
-				break;
-			}
-	return file_elem;
+	int fd;
+	
+	ASSERT (file != NULL);
+	
+	for (fd = curr->fd_free; fd < curr->fd_cap; fd++)
+		if (curr->fd_table[fd] == NULL)
+			break;
+	
+	if (fd == curr->fd_cap)
+		{
+			int new_cap = curr->fd_cap == 0 ? FD_TABLE_INIT : curr->fd_cap * 2;
+			struct file **new_table = realloc (curr->fd_table,
+			                                   new_cap * sizeof *new_table);
+			if (new_table == NULL)
+				return -1;
+			memset (new_table + curr->fd_cap, 0,
+			        (new_cap - curr->fd_cap) * sizeof *new_table);
+			curr->fd_table = new_table;
+			curr->fd_cap = new_cap;
+		}
+	
+	curr->fd_table[fd] = file;
+	curr->fd_free = fd + 1;
+	return fd;
+}
+
+/* Get the file with given file descriptor, or a null pointer if
+   FD is not open. */
+struct file *
+thread_get_file (int fd)
+{
+	struct thread *curr = thread_current ();
+	
+	if (fd < FD_MIN || fd >= curr->fd_cap)
+		return NULL;
+	return curr->fd_table[fd];
+}
+
+/* Removes FD from the current process's fd table, making it
+   available for reuse, and returns the file it referred to.
+   Returns a null pointer if FD is not open.  The caller must
+   close the file. */
+struct file *
+thread_remove_file (int fd)
+{
+	struct thread *curr = thread_current ();
+	struct file *file = thread_get_file (fd);
+	
+	if (file != NULL)
+		{
+			curr->fd_table[fd] = NULL;
+			if (fd < curr->fd_free)
+				curr->fd_free = fd;
+		}
+	return file;
+}
+
+/* Closes every file the current process has open and frees its
+   fd table. */
+void
+thread_close_files (void)
+{
+	struct thread *curr = thread_current ();
+	int fd;
+	
+	for (fd = FD_MIN; fd < curr->fd_cap; fd++)
+		file_close (curr->fd_table[fd]);
+	free (curr->fd_table);
+	curr->fd_table = NULL;
+	curr->fd_cap = 0;
+	curr->fd_free = FD_MIN;
 }
 #endif
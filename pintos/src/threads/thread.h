@@ -1,6 +1,7 @@
 #ifndef THREADS_THREAD_H
 #define THREADS_THREAD_H
 
+#include <console.h>
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
@@ -112,9 +113,22 @@ struct thread
     struct semaphore *sema_dealloc;			/* Semaphore for deallocation of child. */
     struct semaphore sema_exec;					/* Semaphore for execution. */
     int exit_status;										/* Status when the thread exits. */
-    struct list open_files;							/* List of open files. */
+    struct file **fd_table;							/* Open files, indexed by fd. */
+    int fd_cap;													/* Number of slots in fd_table. */
+    int fd_free;												/* No free fd is below this one. */
+    struct dir *cwd;										/* Working directory, or null for root. */
 #endif
 
+#ifdef FILESYS
+    /* Owned by filesys/journal.c. */
+    int journal_depth;									/* Nesting of journal operations. */
+#endif
+
+    /* Owned by lib/kernel/console.c. */
+    char console_line[CONSOLE_LINE_MAX];	/* Output not yet written. */
+    size_t console_len;									/* Bytes in console_line. */
+    bool console_flushing;							/* Writing console_line out? */
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -163,12 +177,9 @@ struct list *get_ready_list (void);
 /* Project 2. */
 struct thread * get_thread (tid_t);
 void remove_thread (tid_t);
-struct file_elem
-{
-	struct file *file;
-	int fd;
-	struct list_elem elem;
-};
-struct file_elem * thread_get_file_elem (int);
+int thread_add_file (struct file *);
+struct file * thread_get_file (int);
+struct file * thread_remove_file (int);
+void thread_close_files (void);
 
 #endif /* threads/thread.h */
@@ -4,7 +4,9 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -127,6 +129,7 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  void *fixup;       /* Where a faulting user access resumes. */
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -148,6 +151,16 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
+
+  /* A kernel access to user memory through userprog/uaccess.c
+     resumes at its fixup, which reports the failure to the
+     caller. */
+  if (!user && is_user_vaddr (fault_addr)
+      && (fixup = uaccess_fixup ((void *) f->eip)) != NULL)
+    {
+      f->eip = (void (*) (void)) fixup;
+      return;
+    }
   
   exit_abnormal ();
 
@@ -22,8 +22,6 @@
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
-extern struct lock filesys_lock;
-
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -55,13 +53,10 @@ process_execute (const char *file_name)
   char *ptr_sav;
   name = strtok_r (name, " ", &ptr_sav);
   
-  /* Check if the file is in the directory. */
-	struct dir *dir = dir_open_root ();
-	struct inode *inode = NULL;
-	if (dir != NULL)
-		dir_lookup (dir, name, &inode);
-	dir_close (dir);
-	if (inode == NULL)
+  /* Check if the file exists. */
+	struct file *file = filesys_open (name);
+	file_close (file);
+	if (file == NULL)
 		{
 			palloc_free_page (fn_copy);
 			palloc_free_page (name);
@@ -225,6 +220,10 @@ process_exit (void)
   struct semaphore *sema_dealloc = curr->sema_dealloc = (struct semaphore *) malloc (sizeof (struct semaphore));
   sema_init (sema_dealloc, 0);
   
+  thread_close_files ();										/* Close all open files. */
+  dir_close (curr->cwd);										/* Close the working directory. */
+  curr->cwd = NULL;
+  
   sema_up (&curr->sema_parent);							/* Signal to the parent. */
   sema_down (&curr->sema_child);						/* Wait until parent got the signal. */
   
@@ -358,7 +357,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
   process_activate ();
 
   /* Open executable file. */
-  lock_acquire (&filesys_lock);
   file = filesys_open (file_name);
   if (file == NULL) 
     {
@@ -450,7 +448,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
  done:
   /* We arrive here whether the load is successful or not. */
   file_close (file);
-  lock_release (&filesys_lock);
   return success;
 }
 
@@ -6,316 +6,568 @@
 #include "threads/init.h"
 #include "lib/user/syscall.h"
 #include "userprog/process.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include "devices/input.h"
 #include "lib/kernel/console.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
-#include "userprog/pagedir.h"
+#include "userprog/uaccess.h"
+#include <stdint.h>
 #include <string.h>
 
 static void syscall_handler (struct intr_frame *);
-struct lock filesys_lock;
-struct lock fd_lock;
-static char * scalls[13] = {"halt", "exit", "exec", "wait", "create", 
-	"remove", "open", "filesize", "read", "write", "seek", "tell", "close"};
 
-static void ptr_check (void *);
-static uint32_t esp_pop (uint32_t **);
+/* Maximum number of arguments taken by a system call. */
+#define SYSCALL_ARGS_MAX 4
+
+/* Types of system call arguments.  Pointer arguments are
+   validated by syscall_handler() before the handler runs. */
+enum arg_type
+	{
+		ARG_INT,							/* Passed through unchecked. */
+		ARG_STR,							/* User string, copied into a kernel page. */
+		ARG_BUF_IN,						/* User buffer read by the kernel; size follows. */
+		ARG_BUF_OUT						/* User buffer written by the kernel; size follows. */
+	};
+
+/* A system call handler.  Takes the call's arguments and returns
+   the value for the user's %eax. */
+typedef uint32_t syscall_func (const uint32_t *args);
+
+/* A system call table entry. */
+struct syscall
+	{
+		const char *name;											/* Name, for debugging. */
+		syscall_func *func;										/* Handler. */
+		int argc;															/* Number of arguments. */
+		enum arg_type types[SYSCALL_ARGS_MAX];	/* Type of each argument. */
+		uint32_t error;												/* Return value if a string is too long. */
+	};
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create,
+	sys_remove, sys_open, sys_filesize, sys_read, sys_write, sys_seek,
+	sys_tell, sys_close, sys_chdir, sys_mkdir, sys_readdir, sys_isdir,
+	sys_inumber, sys_pread, sys_pwrite, sys_readv, sys_writev;
+
+/* System calls, indexed by SYS_* number. */
+static const struct syscall syscalls[] =
+	{
+		[SYS_HALT] = {"halt", sys_halt, 0, {}},
+		[SYS_EXIT] = {"exit", sys_exit, 1, {ARG_INT}},
+		[SYS_EXEC] = {"exec", sys_exec, 1, {ARG_STR}, -1},
+		[SYS_WAIT] = {"wait", sys_wait, 1, {ARG_INT}},
+		[SYS_CREATE] = {"create", sys_create, 2, {ARG_STR, ARG_INT}, false},
+		[SYS_REMOVE] = {"remove", sys_remove, 1, {ARG_STR}, false},
+		[SYS_OPEN] = {"open", sys_open, 1, {ARG_STR}, -1},
+		[SYS_FILESIZE] = {"filesize", sys_filesize, 1, {ARG_INT}},
+		[SYS_READ] = {"read", sys_read, 3, {ARG_INT, ARG_BUF_OUT, ARG_INT}},
+		[SYS_WRITE] = {"write", sys_write, 3, {ARG_INT, ARG_BUF_IN, ARG_INT}},
+		[SYS_SEEK] = {"seek", sys_seek, 2, {ARG_INT, ARG_INT}},
+		[SYS_TELL] = {"tell", sys_tell, 1, {ARG_INT}},
+		[SYS_CLOSE] = {"close", sys_close, 1, {ARG_INT}},
+		[SYS_CHDIR] = {"chdir", sys_chdir, 1, {ARG_STR}, false},
+		[SYS_MKDIR] = {"mkdir", sys_mkdir, 1, {ARG_STR}, false},
+		[SYS_READDIR] = {"readdir", sys_readdir, 2, {ARG_INT, ARG_INT}},
+		[SYS_ISDIR] = {"isdir", sys_isdir, 1, {ARG_INT}},
+		[SYS_INUMBER] = {"inumber", sys_inumber, 1, {ARG_INT}},
+		[SYS_PREAD] = {"pread", sys_pread, 4,
+		               {ARG_INT, ARG_BUF_OUT, ARG_INT, ARG_INT}},
+		[SYS_PWRITE] = {"pwrite", sys_pwrite, 4,
+		                {ARG_INT, ARG_BUF_IN, ARG_INT, ARG_INT}},
+		[SYS_READV] = {"readv", sys_readv, 3, {ARG_INT, ARG_INT, ARG_INT}},
+		[SYS_WRITEV] = {"writev", sys_writev, 3, {ARG_INT, ARG_INT, ARG_INT}},
+	};
+
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
+
 
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&filesys_lock);
-  lock_init (&fd_lock);
+}
+
+/* Returns the word offset from the user's stack pointer to the
+   first argument of a system call taking ARGC arguments.
+
+   The stubs in lib/user/syscall.c push their arguments with
+   esp-relative operands that gcc computes before the earlier
+   pushes have moved %esp, so only a lone argument is pushed
+   correctly.  With two or more, we instead read the stub
+   caller's own copy of the arguments, which sits above the
+   system call number, the ARGC pushed words and the stub's
+   return address. */
+static inline int
+syscall_args_ofs (int argc)
+{
+	return argc < 2 ? 1 : argc + 2;
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
-  uint32_t *sp = f->esp;
-  uint32_t **esp = &sp;
-  //hex_dump ((uintptr_t) *esp, *esp, 64, true);
-  int sys_num = (int) esp_pop (esp);
+	const uint32_t *esp = f->esp;
+	const struct syscall *sc;
+	uint32_t args[SYSCALL_ARGS_MAX];
+	char *strs[SYSCALL_ARGS_MAX];
+	unsigned sys_num;
+	int ofs, len, i;
+	
+	/* Fetch the system call number. */
+	if (!copy_from_user (&sys_num, esp, sizeof sys_num)
+			|| sys_num >= SYSCALL_CNT || syscalls[sys_num].func == NULL)
+		exit_abnormal ();
+	sc = &syscalls[sys_num];
+	
+	/* Copy all of the arguments at once. */
+	ofs = syscall_args_ofs (sc->argc);
+	if (!copy_from_user (args, esp + ofs, sc->argc * sizeof *esp))
+		exit_abnormal ();
+	
+	/* Copy in strings and probe buffers.  Buffers are used in
+	   place, under file system and console locks, so they must be
+	   known good before the handler runs. */
+	memset (strs, 0, sizeof strs);
+	for (i = 0; i < sc->argc; i++)
+		switch (sc->types[i])
+			{
+			case ARG_INT:
+				break;
+			case ARG_STR:
+				/* Only a bad pointer kills the process.  A string that
+				   does not fit in a page, or a lack of memory, makes
+				   the call fail. */
+				strs[i] = palloc_get_page (0);
+				if (strs[i] == NULL)
+					goto error;
+				len = strncpy_from_user (strs[i], (const char *) args[i], PGSIZE);
+				if (len < 0)
+					goto fail;
+				if (len >= PGSIZE)
+					goto error;
+				args[i] = (uint32_t) strs[i];
+				break;
+			case ARG_BUF_IN:
+			case ARG_BUF_OUT:
+				ASSERT (i + 1 < sc->argc);
+				if (!probe_user ((const void *) args[i],
+				                 args[i + 1] > 0 ? args[i + 1] : 1,
+				                 sc->types[i] == ARG_BUF_OUT))
+					goto fail;
+				break;
+			}
 	
-	//printf("%s-%d called %s\n", thread_name (), thread_current ()->tid, scalls[sys_num]);
+	f->eax = sc->func (args);
+	
+	for (i = 0; i < sc->argc; i++)
+		palloc_free_page (strs[i]);
+	return;
+	
+ error:
+	f->eax = sc->error;
+	for (i = 0; i < sc->argc; i++)
+		palloc_free_page (strs[i]);
+	return;
+	
+ fail:
+	for (i = 0; i < sc->argc; i++)
+		palloc_free_page (strs[i]);
+	exit_abnormal ();
+}
 
-  switch (sys_num)
-		{
-		case SYS_HALT: // sys# 0.
-		{
-			power_off ();
-			break;
-		}
-		
-		case SYS_EXIT: // sys# 1.
-		{
-			int status = (int) esp_pop (esp);
-			
-			printf("%s: exit(%d)\n", thread_name (), status);
-			thread_current ()->exit_status = status;
-			thread_exit ();
-		}
-		
-		case SYS_EXEC: // sys# 2.
-		{
-			const char *cmd_line = (const char *) esp_pop (esp);
-			
-			ptr_check ((void *) cmd_line);
-			
-			lock_acquire (&filesys_lock);
-			tid_t tid = process_execute (cmd_line);
-			f->eax = tid;
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_WAIT: // sys# 3.
-		{
-			pid_t pid = (pid_t) esp_pop (esp);
-			
-			int status = process_wait (pid);
-			f->eax = status;
-			break;
-		}
-		
-		case SYS_CREATE: // sys# 4.
-		{
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
-			const char *file = (const char *) esp_pop (esp);
-			unsigned size = (unsigned) esp_pop (esp);
-			
-			ptr_check ((void *) file);
-			
-			lock_acquire (&filesys_lock);
-			bool success = filesys_create (file, size);
-			f->eax = success;
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_REMOVE: // sys# 5.
-		{
-			const char *file = (const char *) esp_pop (esp);
-			
-			ptr_check ((void *) file);
-			lock_acquire (&filesys_lock);
-			bool success = filesys_remove (file);
-			f->eax = success;
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_OPEN: // sys# 6.
+/* Halts the operating system. */
+static uint32_t
+sys_halt (const uint32_t *args UNUSED)
+{
+	power_off ();
+}
+
+/* Terminates the current process with status ARGS[0]. */
+static uint32_t
+sys_exit (const uint32_t *args)
+{
+	int status = (int) args[0];
+	
+	printf("%s: exit(%d)\n", thread_name (), status);
+	thread_current ()->exit_status = status;
+	thread_exit ();
+}
+
+/* Runs the command line ARGS[0] in a new process. */
+static uint32_t
+sys_exec (const uint32_t *args)
+{
+	const char *cmd_line = (const char *) args[0];
+	
+	return process_execute (cmd_line);
+}
+
+/* Waits for child process ARGS[0] to exit. */
+static uint32_t
+sys_wait (const uint32_t *args)
+{
+	pid_t pid = (pid_t) args[0];
+	
+	return process_wait (pid);
+}
+
+/* Creates file ARGS[0] with initial size ARGS[1]. */
+static uint32_t
+sys_create (const uint32_t *args)
+{
+	const char *file = (const char *) args[0];
+	unsigned size = (unsigned) args[1];
+	
+	return filesys_create (file, size);
+}
+
+/* Deletes file ARGS[0]. */
+static uint32_t
+sys_remove (const uint32_t *args)
+{
+	const char *file = (const char *) args[0];
+	
+	return filesys_remove (file);
+}
+
+/* Opens file ARGS[0] and returns its descriptor, or -1. */
+static uint32_t
+sys_open (const uint32_t *args)
+{
+	const char *name = (const char *) args[0];
+	struct file *file = filesys_open (name);
+	int fd;
+	
+	if (file == NULL)
+		return -1;
+	
+	if (strcmp (thread_name (), name) == 0)
+			file_deny_write (file);
+	
+	fd = thread_add_file (file);
+	if (fd == -1)
+		file_close (file);
+	return fd;
+}
+
+/* Returns the size of open file ARGS[0]. */
+static uint32_t
+sys_filesize (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	return file_length (file);
+}
+
+/* Reads ARGS[2] bytes from fd ARGS[0] into buffer ARGS[1]. */
+static uint32_t
+sys_read (const uint32_t *args)
+{
+	int fd = (int) args[0];
+	char *buffer = (char *) args[1];
+	unsigned size = (unsigned) args[2];
+	unsigned bytes;
+	struct file *file;
+	
+	/* Standard input. */
+	if (fd == 0)
 		{
-			const char *name = (const char *) esp_pop (esp);
-			ptr_check ((void *) name);
-			
-			lock_acquire (&filesys_lock);
-			struct file *file = filesys_open (name);
-			
-			if (file == NULL)
-				{
-					f->eax = -1;
-					lock_release (&filesys_lock);
-					break;
-				}
-			
-			if (strcmp (thread_name (), name) == 0)
-					file_deny_write (file);
-			
-			int fd = 2;
-			if (!list_empty (&thread_current ()->open_files))
-				fd = list_entry (list_back (&thread_current ()->open_files), struct file_elem, elem)->fd + 1;
-			struct file_elem *file_elem = (struct file_elem *) malloc (sizeof (struct file_elem));
-			file_elem->file = file;
-			file_elem->fd = fd;
-			list_push_back (&thread_current ()->open_files, &file_elem->elem);
-			f->eax = fd;
-			lock_release (&filesys_lock);
-			break;
+			for (bytes = 0; bytes < size; bytes++)
+				buffer[bytes] = input_getc ();
+			return size;
 		}
-		
-		case SYS_FILESIZE: // sys#. 7
+	
+	/* Read files. */
+	file = thread_get_file (fd);
+	if (file == NULL)
+		exit_abnormal ();
+	if (inode_is_dir (file_get_inode (file)))
+		return -1;
+	
+	return file_read (file, buffer, size);
+}
+
+/* Writes ARGS[2] bytes from buffer ARGS[1] to fd ARGS[0]. */
+static uint32_t
+sys_write (const uint32_t *args)
+{
+	int fd = (int) args[0];
+	const char *buffer = (const char *) args[1];
+	unsigned size = (unsigned) args[2];
+	struct file *file;
+	
+	/* Standard output. */
+	if (fd == 1)
 		{
-			int fd = (int) esp_pop (esp);
-			
-			lock_acquire (&filesys_lock);
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			struct file *file = file_elem->file;
-			int size = -1;
-			if (file != NULL)
-				size = file_length (file);
-			f->eax = size;
-			lock_release (&filesys_lock);
-			break;
+			putbuf (buffer, size);
+			return size;
 		}
-		
-		case SYS_READ: // sys# 8.
+	
+	file = thread_get_file (fd);
+	if (file == NULL)
+		exit_abnormal ();
+	if (inode_is_dir (file_get_inode (file)))
+		return -1;
+	
+	return file_write (file, buffer, size);
+}
+
+/* Moves the position of fd ARGS[0] to ARGS[1]. */
+static uint32_t
+sys_seek (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	unsigned position = (unsigned) args[1];
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	file_seek (file, position);
+	return 0;
+}
+
+/* Returns the position of fd ARGS[0]. */
+static uint32_t
+sys_tell (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	return file_tell (file);
+}
+
+/* Closes fd ARGS[0]. */
+static uint32_t
+sys_close (const uint32_t *args)
+{
+	struct file *file = thread_remove_file ((int) args[0]);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	file_close (file);
+	return 0;
+}
+
+/* Changes the working directory to ARGS[0]. */
+static uint32_t
+sys_chdir (const uint32_t *args)
+{
+	const char *dir = (const char *) args[0];
+	
+	return filesys_chdir (dir);
+}
+
+/* Creates directory ARGS[0]. */
+static uint32_t
+sys_mkdir (const uint32_t *args)
+{
+	const char *dir = (const char *) args[0];
+	
+	return filesys_mkdir (dir);
+}
+
+/* Reads the next entry of directory fd ARGS[0] into the
+   READDIR_MAX_LEN + 1 byte user buffer ARGS[1]. */
+static uint32_t
+sys_readdir (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	char *uname = (char *) args[1];
+	char name[NAME_MAX + 1];
+	off_t pos;
+	
+	if (file == NULL)
+		exit_abnormal ();
+	if (!inode_is_dir (file_get_inode (file)))
+		return false;
+	
+	/* The directory position is kept as the file position. */
+	pos = file_tell (file);
+	if (!dir_readdir_at (file_get_inode (file), &pos, name))
+		return false;
+	file_seek (file, pos);
+	
+	if (!copy_to_user (uname, name, strlen (name) + 1))
+		exit_abnormal ();
+	return true;
+}
+
+/* Returns whether fd ARGS[0] is a directory. */
+static uint32_t
+sys_isdir (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	return inode_is_dir (file_get_inode (file));
+}
+
+/* Returns the inode number of fd ARGS[0]. */
+static uint32_t
+sys_inumber (const uint32_t *args)
+{
+	struct file *file = thread_get_file ((int) args[0]);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	
+	return inode_get_inumber (file_get_inode (file));
+}
+
+/* Returns the open regular file for fd FD, or a null pointer if
+   FD is a directory.  Kills the process if FD is not open. */
+static struct file *
+get_regular_file (int fd)
+{
+	struct file *file = thread_get_file (fd);
+	
+	if (file == NULL)
+		exit_abnormal ();
+	if (inode_is_dir (file_get_inode (file)))
+		return NULL;
+	return file;
+}
+
+/* Reads ARGS[2] bytes at position ARGS[3] of fd ARGS[0] into
+   buffer ARGS[1], without moving the fd's position. */
+static uint32_t
+sys_pread (const uint32_t *args)
+{
+	struct file *file = get_regular_file ((int) args[0]);
+	void *buffer = (void *) args[1];
+	unsigned size = (unsigned) args[2];
+	unsigned position = (unsigned) args[3];
+	
+	/* Positions past the largest off_t would turn negative. */
+	if (file == NULL || position > INT32_MAX)
+		return -1;
+	
+	return file_read_at (file, buffer, size, position);
+}
+
+/* Writes ARGS[2] bytes from buffer ARGS[1] at position ARGS[3] of
+   fd ARGS[0], without moving the fd's position. */
+static uint32_t
+sys_pwrite (const uint32_t *args)
+{
+	struct file *file = get_regular_file ((int) args[0]);
+	const void *buffer = (const void *) args[1];
+	unsigned size = (unsigned) args[2];
+	unsigned position = (unsigned) args[3];
+	
+	if (file == NULL || position > INT32_MAX)
+		return -1;
+	
+	return file_write_at (file, buffer, size, position);
+}
+
+/* Copies the CNT segment user iovec array UIOV into IOV and
+   checks that every segment can be accessed, for writing if
+   WRITE is true.  Returns false if CNT is out of range; kills the
+   process if any of the memory is bad. */
+static bool
+copy_iov (struct iovec iov[IOV_MAX], const struct iovec *uiov, int cnt,
+          bool write)
+{
+	int i;
+	
+	if (cnt < 0 || cnt > IOV_MAX)
+		return false;
+	if (!copy_from_user (iov, uiov, cnt * sizeof *iov))
+		exit_abnormal ();
+	for (i = 0; i < cnt; i++)
+		if (iov[i].iov_len > 0
+				&& !probe_user (iov[i].iov_base, iov[i].iov_len, write))
+			exit_abnormal ();
+	return true;
+}
+
+/* Reads from fd ARGS[0] into the ARGS[2] segments described by
+   the iovec array ARGS[1], in order. */
+static uint32_t
+sys_readv (const uint32_t *args)
+{
+	int fd = (int) args[0];
+	struct iovec iov[IOV_MAX];
+	int cnt = (int) args[2];
+	struct file *file;
+	
+	if (!copy_iov (iov, (const struct iovec *) args[1], cnt, true))
+		return -1;
+	
+	/* Standard input. */
+	if (fd == 0)
 		{
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
-			
-			int fd = (int) esp_pop (esp);
-			char *buffer = (char *) esp_pop (esp);
-			unsigned size = (unsigned) esp_pop (esp);
-			unsigned bytes;
-			
-			ptr_check ((void *) buffer);
-			
-			lock_acquire (&filesys_lock);
-			
-			/* Standard input. */
-			if (fd == 0)
-				{
-					for (bytes = 0; bytes < size; bytes++);
-						buffer[bytes] = input_getc ();
-					f->eax = size;
-					lock_release (&filesys_lock);
-					break;
-				}
-			
-			/* Read files. */
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			struct file *file = file_elem->file;
-			bytes = file_read (file, (void *) buffer, size);
-			f->eax = bytes;
-			lock_release (&filesys_lock);
-			break;
+			unsigned bytes = 0;
+			int i;
+			size_t j;
+			
+			for (i = 0; i < cnt; i++)
+				for (j = 0; j < iov[i].iov_len; j++, bytes++)
+					((char *) iov[i].iov_base)[j] = input_getc ();
+			return bytes;
 		}
-		
-		case SYS_WRITE: // sys# 9.
+	
+	file = get_regular_file (fd);
+	if (file == NULL)
+		return -1;
+	
+	return file_readv (file, iov, cnt);
+}
+
+/* Writes the ARGS[2] segments described by the iovec array
+   ARGS[1] to fd ARGS[0], in order. */
+static uint32_t
+sys_writev (const uint32_t *args)
+{
+	int fd = (int) args[0];
+	struct iovec iov[IOV_MAX];
+	int cnt = (int) args[2];
+	struct file *file;
+	
+	if (!copy_iov (iov, (const struct iovec *) args[1], cnt, false))
+		return -1;
+	
+	/* Standard output. */
+	if (fd == 1)
 		{
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
+			unsigned bytes = 0;
+			int i;
 			
-			int fd = (int) esp_pop (esp);
-			const char *buffer = (const char *) esp_pop (esp);
-			unsigned size = (unsigned) esp_pop (esp);
-			unsigned bytes;
-			
-			ptr_check ((void *) buffer);
-			
-			lock_acquire (&filesys_lock);
-			/* Standard output. */
-			if (fd == 1)
+			for (i = 0; i < cnt; i++)
 				{
-					putbuf (buffer, size);
-					f->eax = size;
-					lock_release (&filesys_lock);
-					break;
+					putbuf (iov[i].iov_base, iov[i].iov_len);
+					bytes += iov[i].iov_len;
 				}
-			
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			struct file *file = file_elem->file;
-			bytes = file_write (file, (void *) buffer, size);
-			f->eax = bytes;
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_SEEK: // sys# 10.
-		{
-			esp_pop (esp);
-			esp_pop (esp);
-			esp_pop (esp);
-			
-			int fd = (int) esp_pop (esp);
-			unsigned position = (unsigned) esp_pop (esp);
-			
-			lock_acquire (&filesys_lock);
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			struct file *file = file_elem->file;
-			file_seek (file, position);
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_TELL: // sys# 11.
-		{
-			int fd = (int) esp_pop (esp);
-			int position;
-			
-			lock_acquire (&filesys_lock);
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			struct file *file = file_elem->file;
-			position = file_tell (file);
-			f->eax = position;
-			lock_release (&filesys_lock);
-			break;
-		}
-		
-		case SYS_CLOSE: // sys# 12.
-		{
-			int fd = (int) esp_pop (esp);
-			
-			lock_acquire (&filesys_lock);
-			struct file_elem *file_elem = thread_get_file_elem (fd);
-			if (file_elem == NULL)
-				exit_abnormal ();
-			
-			file_close (file_elem->file);
-			list_remove (&file_elem->elem);
-			free (file_elem);
-			lock_release (&filesys_lock);
-			break;
-		}
+			return bytes;
 		}
+	
+	file = get_regular_file (fd);
+	if (file == NULL)
+		return -1;
+	
+	return file_writev (file, iov, cnt);
 }
 
 /* Exit abnormally with termination message. */
 void
 exit_abnormal (void)
 {
-	if (filesys_lock.holder == thread_current ())
-		lock_release (&filesys_lock);
 	printf("%s: exit(-1)\n", thread_name ());
 	thread_current ()->exit_status = -1;
 	thread_exit ();
 }
-
-/* Checks if the pointer is valid in user space. */
-static void
-ptr_check (void *ptr)
-{
-	if ((ptr != NULL) && is_user_vaddr (ptr) && (pagedir_get_page (thread_current ()->pagedir, ptr) != NULL))
-		return;
-	
-	exit_abnormal ();
-}
-
-/* Pops an argument from the stack. */
-static uint32_t
-esp_pop (uint32_t **esp)
-{
-	ptr_check (*esp);
-	uint32_t arg = **esp;
-	(*esp)++;
-	return arg;
-}
@@ -0,0 +1,154 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Every instruction below that touches a user address has an
+   entry in the `ex_table' section giving the address to resume
+   at if it faults.  The linker script gathers the entries between
+   _start_ex_table and _end_ex_table. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Returns true if the SIZE bytes starting at UADDR all lie in user
+   virtual memory. */
+static inline bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  uintptr_t end = start + size;
+  return end >= start && end <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be a
+   user address.  Returns the number of bytes left uncopied,
+   which is nonzero only if a user page faulted.  After a fault in
+   `rep movsb', %ecx still holds the remaining count. */
+static inline size_t
+copy_user (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                ".section ex_table, \"a\"\n"
+                "   .long 1b, 2b\n"
+                ".previous"
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Reads a byte at user virtual address USRC into *DST.
+   Returns true if successful, false if USRC faulted. */
+static inline bool
+get_user (uint8_t *dst, const uint8_t *usrc)
+{
+  int ok;
+  uint8_t byte;
+  asm volatile ("1: movb %2, %1\n"
+                "   movl $1, %0\n"
+                "2:\n"
+                ".section ex_table, \"a\"\n"
+                "   .long 1b, 2b\n"
+                ".previous"
+                : "=r" (ok), "=q" (byte)
+                : "m" (*usrc), "0" (0));
+  if (ok)
+    *dst = byte;
+  return ok;
+}
+
+/* Writes BYTE to user address UDST.
+   Returns true if successful, false if UDST faulted. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int ok;
+  asm volatile ("1: movb %2, %1\n"
+                "   movl $1, %0\n"
+                "2:\n"
+                ".section ex_table, \"a\"\n"
+                "   .long 1b, 2b\n"
+                ".previous"
+                : "=r" (ok), "=m" (*udst)
+                : "q" (byte), "0" (0));
+  return ok;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns true if successful, false if any of the source is not
+   mapped user memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) 
+{
+  return is_user_range (usrc, size) && copy_user (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns true if successful, false if any of the destination is
+   not mapped user memory.  (Bytes before the bad page may have
+   been written.) */
+bool
+copy_to_user (void *udst, const void *src, size_t size) 
+{
+  return is_user_range (udst, size) && copy_user (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string, or SIZE if it does not fit (in which case DST is not
+   null-terminated), or -1 if USRC is not mapped user memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++) 
+    {
+      if (!is_user_vaddr (usrc + i)
+          || !get_user ((uint8_t *) dst + i, (const uint8_t *) usrc + i))
+        return -1;
+      if (dst[i] == '\0')
+        return i;
+    }
+  return size;
+}
+
+/* Touches every page of the SIZE-byte user buffer UBUF, reading
+   one byte from each, and also writing it back if WRITE is true.
+   Returns true if every page is mapped (and writable, if WRITE),
+   false otherwise.  Used for buffers that the kernel accesses
+   while holding locks, where a fault must not happen midway. */
+bool
+probe_user (const void *ubuf, size_t size, bool write) 
+{
+  const uint8_t *p = ubuf;
+  const uint8_t *end = p + size;
+  uint8_t byte;
+
+  if (!is_user_range (ubuf, size))
+    return false;
+
+  for (; p < end; p = (const uint8_t *) pg_round_down (p) + PGSIZE)
+    if (!get_user (&byte, p) || (write && !put_user ((uint8_t *) p, byte)))
+      return false;
+  return true;
+}
+
+/* If EIP is an instruction that is allowed to fault on a user
+   address, returns the address to resume execution at.
+   Otherwise, returns a null pointer. */
+void *
+uaccess_fixup (const void *eip) 
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) eip)
+      return (void *) e->fixup;
+  return NULL;
+}
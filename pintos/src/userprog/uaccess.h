@@ -0,0 +1,19 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Copying to and from user memory.
+   These do not check page tables.  They just access the user
+   address and, if it faults, page_fault() resumes at a fixup
+   that makes the function report failure. */
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+bool probe_user (const void *ubuf, size_t size, bool write);
+
+/* Exception table lookup for page_fault(). */
+void *uaccess_fixup (const void *eip);
+
+#endif /* userprog/uaccess.h */